@@ -19,6 +19,41 @@ IoIn32:
     in eax, dx
     ret
 
+global IoOut16  ; void IoOut16(uint16_t addr, uint16_t data);
+IoOut16:
+    mov dx, di    ; dx = addr
+    mov ax, si    ; ax = data
+    out dx, ax
+    ret
+
+global IoIn16  ; uint16_t IoIn16(uint16_t addr);
+IoIn16:
+    mov dx, di    ; dx = addr
+    xor eax, eax
+    in ax, dx
+    ret
+
+global IoOut8  ; void IoOut8(uint16_t addr, uint8_t data);
+IoOut8:
+    mov dx, di    ; dx = addr
+    mov al, sil   ; al = data
+    out dx, al
+    ret
+
+global IoIn8  ; uint8_t IoIn8(uint16_t addr);
+IoIn8:
+    mov dx, di    ; dx = addr
+    xor eax, eax
+    in al, dx
+    ret
+
+global ReadTSC  ; uint64_t ReadTSC(void);
+ReadTSC:
+    rdtsc         ; edx:eax = TSC
+    shl rdx, 32
+    or rax, rdx
+    ret
+
 global GetCS  ; uint16_t GetCS(void);
 GetCS:
     xor eax, eax  ; also clears upper 32 bits of rax
@@ -84,6 +119,50 @@ SetCR3:
     ret
 ; #@@range_end(set_cr3)
 
+global ReadMSR  ; uint64_t ReadMSR(uint32_t msr);
+ReadMSR:
+    mov ecx, edi
+    rdmsr         ; edx:eax = MSR[ecx]
+    shl rdx, 32
+    or rax, rdx
+    ret
+
+global WriteMSR  ; void WriteMSR(uint32_t msr, uint64_t value);
+WriteMSR:
+    mov ecx, edi
+    mov eax, esi
+    mov rdx, rsi
+    shr rdx, 32
+    wrmsr
+    ret
+
+global GetCR4  ; uint64_t GetCR4(void);
+GetCR4:
+    mov rax, cr4
+    ret
+
+global SetCR4  ; void SetCR4(uint64_t value);
+SetCR4:
+    mov cr4, rdi
+    ret
+
+global GetXCR0  ; uint64_t GetXCR0(void);
+GetXCR0:
+    xor ecx, ecx  ; XCR0
+    xgetbv        ; edx:eax = XCR0
+    shl rdx, 32
+    or rax, rdx
+    ret
+
+global SetXCR0  ; void SetXCR0(uint64_t value);
+SetXCR0:
+    xor ecx, ecx  ; XCR0
+    mov eax, edi
+    mov rdx, rdi
+    shr rdx, 32
+    xsetbv
+    ret
+
 ; #@@range_begin(set_main_stack)
 extern kernel_main_stack
 extern KernelMainNewStack
@@ -0,0 +1,422 @@
+/**
+ * @file bench/bench.cpp
+ *
+ * 描画処理をホスト上で計測する。カーネルと同じ構成のデスクトップを
+ * RAM 上のフレームバッファに作り，代表的な場面ごとに1フレームあたりの時間と
+ * 書き込んだ1ピクセルあたりの時間を表示する。
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "blit.hpp"
+#include "console.hpp"
+#include "font.hpp"
+#include "frame_buffer.hpp"
+#include "graphics.hpp"
+#include "layer.hpp"
+#include "mouse.hpp"
+#include "raster.hpp"
+#include "window.hpp"
+
+// desktop
+namespace {
+const int kScreenWidth = 1024;
+const int kScreenHeight = 768;
+const PixelFormat kPixelFormat = kPixelBGRResv8BitPerColor;
+const PixelColor kDesktopFGColor{255, 255, 255};
+const PixelColor kDesktopBGColor{45, 118, 237};
+
+/** @brief カーネルの KernelMain と同じ構成のデスクトップ
+ *
+ * 背景，コンソール，マウスカーソルを持ち，合成は FrameScheduler と同じく
+ * 再描画範囲を記録してから ComposeFrame でまとめて行う
+ */
+class Desktop {
+public:
+  Desktop()
+      : vram_(static_cast<size_t>(kScreenWidth) * kScreenHeight),
+        console_{kDesktopFGColor, kDesktopBGColor} {
+    const FrameBufferConfig config{reinterpret_cast<uint8_t *>(vram_.data()),
+                                   kScreenWidth, kScreenWidth, kScreenHeight,
+                                   kPixelFormat};
+    screen_.Initialize(config);
+    screen_.InitializeBackBuffer();
+    layer_manager = &manager_;
+    manager_.SetWriter(&screen_);
+
+    auto bgwindow = std::make_shared<Window>(
+        kScreenWidth, kScreenHeight, kPixelFormat, Window::Surface::kIndexed);
+    DrawDesktop(*bgwindow->Writer());
+    auto console_window = std::make_shared<Window>(
+        Console::kColumns * 8, Console::kRows * 16, kPixelFormat,
+        Window::Surface::kIndexed);
+    console_.SetWindow(console_window);
+    auto mouse_window =
+        std::make_shared<Window>(kMouseCursorWidth, kMouseCursorHeight,
+                                 kPixelFormat, Window::Surface::kIndexed);
+    mouse_window->SetTransparentColor(kMouseTransparentColor);
+    DrawMouseCursor(mouse_window->Writer(), {0, 0});
+
+    const auto bglayer_id =
+        manager_.NewLayer().SetWindow(bgwindow).Move({0, 0}).ID();
+    console_.SetLayerID(
+        manager_.NewLayer().SetWindow(console_window).Move({0, 0}).ID());
+    manager_.UpDown(bglayer_id, 0);
+    manager_.UpDown(console_.LayerID(), 1);
+    manager_.Draw();
+    manager_.SetCursor(mouse_window, {200, 200});
+    manager_.SetDeferred(true);
+  }
+
+  ~Desktop() { layer_manager = nullptr; }
+
+  FrameBuffer &Screen() { return screen_; }
+  LayerManager &Manager() { return manager_; }
+  Console &GetConsole() { return console_; }
+
+private:
+  std::vector<uint32_t> vram_;
+  FrameBuffer screen_;
+  LayerManager manager_;
+  Console console_;
+};
+} // namespace
+// desktop
+
+// measure
+namespace {
+/** @brief 1つの場面の計測結果 */
+struct Result {
+  unsigned long frames;
+  double elapsed_ns;
+  /** @brief 合成したピクセル数（LayerManager::DrawnPixels の増分） */
+  unsigned long drawn_pixels;
+  /** @brief VRAM へ書き込んだピクセル数（PresentedPixels の増分） */
+  unsigned long presented_pixels;
+};
+
+void PrintHeader() {
+  printf("%-16s %8s %12s %12s %10s %12s\n", "scene", "frames", "frames/s",
+         "us/frame", "ns/pixel", "pixels/frame");
+}
+
+void PrintResult(const char *name, const Result &result) {
+  const double frames = result.frames;
+  const double pixels = result.drawn_pixels;
+  printf("%-16s %8lu %12.1f %12.2f %10.3f %12.0f\n", name, result.frames,
+         frames * 1e9 / result.elapsed_ns, result.elapsed_ns / frames / 1e3,
+         pixels > 0 ? result.elapsed_ns / pixels : 0.0, pixels / frames);
+  if (result.presented_pixels > 0) {
+    printf("%-16s %8s %12s %12s %10s %12.0f\n", "  (to VRAM)", "", "", "", "",
+           result.presented_pixels / frames);
+  }
+}
+
+/** @brief frame(i) を frames 回呼び，デスクトップの計数の増分と時間を測る */
+template <class F>
+Result MeasureScene(Desktop &desktop, unsigned long frames, F frame) {
+  const auto drawn = desktop.Manager().DrawnPixels();
+  const auto presented = desktop.Screen().PresentedPixels();
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < frames; ++i) {
+    frame(i);
+    desktop.Manager().ComposeFrame();
+  }
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return {frames, elapsed.count(), desktop.Manager().DrawnPixels() - drawn,
+          desktop.Screen().PresentedPixels() - presented};
+}
+
+/** @brief 描画関数 draw(i) を frames 回呼んで時間を測る
+ *
+ * 1回の呼び出しで pixels_per_call ピクセルを書き込むものとして数える
+ */
+template <class F>
+Result MeasurePrimitive(unsigned long frames, unsigned long pixels_per_call,
+                        F draw) {
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < frames; ++i) {
+    draw(i);
+  }
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return {frames, elapsed.count(), frames * pixels_per_call, 0};
+}
+
+/** @brief 書き込まれるピクセルを数えるだけの PixelWriter
+ *
+ * 描く画素の数が形から簡単に求まらない描画関数の pixels_per_call を数える
+ */
+class PixelCounter : public PixelWriter {
+public:
+  PixelCounter(int width, int height) : width_{width}, height_{height} {}
+  virtual void Write(Vector2D<int> pos, const PixelColor &c) override {
+    ++count_;
+  }
+  virtual int Width() const override { return width_; }
+  virtual int Height() const override { return height_; }
+  virtual void FillSpan(Vector2D<int> pos, int length,
+                        const PixelColor &c) override {
+    count_ += length;
+  }
+
+  unsigned long Count() const { return count_; }
+
+private:
+  int width_, height_;
+  unsigned long count_{0};
+};
+} // namespace
+// measure
+
+// scenes
+namespace {
+/** @brief マウスカーソルを円を描くように動かす */
+Result CursorMove() {
+  Desktop desktop;
+  const Vector2D<int> center{kScreenWidth / 2, kScreenHeight / 2};
+  return MeasureScene(desktop, 20000, [&](unsigned long i) {
+    // 1フレームに数ピクセルずつ動く。三角関数を使わず正方形の周に沿わせる
+    const int side = 400, step = 4;
+    const int t = static_cast<int>(i * step % (4 * side));
+    Vector2D<int> pos{-side / 2, -side / 2};
+    if (t < side) {
+      pos.x += t;
+    } else if (t < 2 * side) {
+      pos = {side / 2, -side / 2 + (t - side)};
+    } else if (t < 3 * side) {
+      pos = {side / 2 - (t - 2 * side), side / 2};
+    } else {
+      pos.y = side / 2 - (t - 3 * side);
+    }
+    desktop.Manager().MoveCursor(center + pos);
+  });
+}
+
+/** @brief コンソールに1フレームで1行ずつ書き，画面を流す */
+Result ConsoleScroll() {
+  Desktop desktop;
+  auto &console = desktop.GetConsole();
+  char line[Console::kColumns + 2];
+  return MeasureScene(desktop, 2000, [&](unsigned long i) {
+    snprintf(line, sizeof(line), "line %6lu: the quick brown fox jumps over "
+                                 "the lazy dog\n", i);
+    console.PutString(line);
+    console.Flush();
+  });
+}
+
+/** @brief 多数のウィンドウを重ねて並べ，1フレームに1つずつ動かす */
+Result ManyWindow() {
+  Desktop desktop;
+  auto &manager = desktop.Manager();
+  const int kWindows = 64;
+  std::vector<unsigned int> ids;
+  for (int i = 0; i < kWindows; ++i) {
+    auto window = std::make_shared<Window>(160, 120, kPixelFormat,
+                                           Window::Surface::kIndexed);
+    DrawWindow(*window->Writer(), "bench");
+    const Vector2D<int> pos{(i % 8) * 100 + (i / 8) * 12, (i / 8) * 70};
+    const auto id = manager.NewLayer().SetWindow(window).Move(pos).ID();
+    manager.UpDown(id, i + 2);
+    ids.push_back(id);
+  }
+  manager.ComposeFrame();
+
+  return MeasureScene(desktop, 5000, [&](unsigned long i) {
+    // 往復させてウィンドウが画面の外へ出ていかないようにする
+    const int dx = (i / kWindows) % 2 == 0 ? 3 : -3;
+    const int dy = (i / kWindows) % 2 == 0 ? 1 : -1;
+    manager.MoveRelative(ids[i % kWindows], {dx, dy});
+  });
+}
+
+/** @brief 1フレームに1つずつウィンドウを開き，一番古いものを閉じる */
+Result LayerChurn() {
+  Desktop desktop;
+  auto &manager = desktop.Manager();
+  const int kWindows = 16;
+  std::vector<unsigned int> ids(kWindows);
+  auto open_window = [&](unsigned long i) {
+    auto window = std::make_shared<Window>(160, 120, kPixelFormat,
+                                           Window::Surface::kIndexed);
+    DrawWindow(*window->Writer(), "churn");
+    const Vector2D<int> pos{static_cast<int>(i * 37 % 800),
+                            static_cast<int>(i * 53 % 600)};
+    const auto id = manager.NewLayer().SetWindow(window).Move(pos).ID();
+    manager.UpDown(id, kWindows + 2);
+    return id;
+  };
+  for (int i = 0; i < kWindows; ++i) {
+    ids[i] = open_window(i);
+  }
+  manager.ComposeFrame();
+
+  return MeasureScene(desktop, 5000, [&](unsigned long i) {
+    auto &id = ids[i % kWindows];
+    manager.RemoveLayer(id);
+    id = open_window(i + kWindows);
+  });
+}
+
+/** @brief 画面全体を合成し直す */
+Result FullRedraw() {
+  Desktop desktop;
+  return MeasureScene(desktop, 200,
+                      [&](unsigned long) { desktop.Manager().Draw(); });
+}
+
+Result FillRectangleScene() {
+  Desktop desktop;
+  auto &writer = desktop.Screen().BackBuffer().Writer();
+  return MeasurePrimitive(20000, 256 * 256, [&](unsigned long i) {
+    FillRectangle(writer, {static_cast<int>(i % 512), 100}, {256, 256},
+                  {static_cast<uint8_t>(i), 0x80, 0x40});
+  });
+}
+
+Result WriteStringScene() {
+  Window window(Console::kColumns * 8, 16, kPixelFormat);
+  const char *s = "The quick brown fox jumps over the lazy dog. 0123456789 "
+                  "ABCDEFGHIJKLMNOPQRSTUVW";
+  return MeasurePrimitive(20000, 8 * 16 * strlen(s), [&](unsigned long i) {
+    WriteString(*window.Writer(), {0, 0}, s, {255, 255, 255}, {0, 0, 0});
+  });
+}
+
+Result WindowDrawToScene() {
+  Desktop desktop;
+  Window window(512, 512, kPixelFormat);
+  FillRectangle(*window.Writer(), {0, 0}, {512, 512}, {0x20, 0x40, 0x80});
+  auto &back_buffer = desktop.Screen().BackBuffer();
+  const Rectangle<int> area{{0, 0}, {kScreenWidth, kScreenHeight}};
+  return MeasurePrimitive(5000, 512 * 512, [&](unsigned long i) {
+    window.DrawTo(back_buffer, {static_cast<int>(i % 256), 100}, area);
+  });
+}
+
+Result FrameBufferCopyScene() {
+  Desktop desktop;
+  FrameBuffer src;
+  src.Initialize({nullptr, 512, 512, 512, kPixelFormat});
+  auto &back_buffer = desktop.Screen().BackBuffer();
+  return MeasurePrimitive(5000, 512 * 512, [&](unsigned long i) {
+    back_buffer.Copy({static_cast<int>(i % 256), 100}, src);
+  });
+}
+
+/** @brief 線分，円，円弧，多角形，角の丸い矩形を1組描く */
+void DrawShapes(PixelWriter &writer, int offset) {
+  const Vector2D<int> origin{100 + offset, 100};
+  const PixelColor c{static_cast<uint8_t>(offset), 0x80, 0x40};
+  for (int i = 0; i <= 16; ++i) {
+    DrawLine(writer, origin, origin + Vector2D<int>{256, i * 16}, c);
+  }
+  FillCircle(writer, origin + Vector2D<int>{400, 128}, 120, c);
+  DrawArc(writer, origin + Vector2D<int>{400, 128}, 130, 200, 340, c);
+  const Vector2D<int> star[] = {{128, 0},   {158, 90},  {254, 90},
+                                {176, 146}, {206, 240}, {128, 182},
+                                {50, 240},  {80, 146},  {2, 90},
+                                {98, 90}};
+  Vector2D<int> points[10];
+  for (int i = 0; i < 10; ++i) {
+    points[i] = origin + Vector2D<int>{0, 300} + star[i];
+  }
+  FillPolygon(writer, points, 10, c);
+  FillRoundedRectangle(writer, origin + Vector2D<int>{300, 300}, {256, 200},
+                       24, c);
+}
+
+Result RasterScene() {
+  Desktop desktop;
+  auto &writer = desktop.Screen().BackBuffer().Writer();
+  PixelCounter counter{kScreenWidth, kScreenHeight};
+  DrawShapes(counter, 0);
+  return MeasurePrimitive(5000, counter.Count(), [&](unsigned long i) {
+    DrawShapes(writer, static_cast<int>(i % 256));
+  });
+}
+
+/** @brief 半透明のウィンドウを1フレームに数ピクセルずつ動かす
+ *
+ * レイヤ全体の不透明度で重ね，下の帯はピクセルごとの不透明度も使う
+ */
+Result LayerAlphaScene() {
+  Desktop desktop;
+  auto &manager = desktop.Manager();
+  auto window = std::make_shared<Window>(320, 240, kPixelFormat,
+                                         Window::Surface::kIndexed);
+  DrawWindow(*window->Writer(), "alpha");
+  window->FillAlpha({{0, 160}, {320, 80}}, 0x80);
+  const auto id =
+      manager.NewLayer().SetWindow(window).SetAlpha(0xc0).Move({0, 100}).ID();
+  manager.UpDown(id, 2);
+  manager.ComposeFrame();
+
+  return MeasureScene(desktop, 5000, [&](unsigned long i) {
+    const int dx = (i / 100) % 2 == 0 ? 4 : -4;
+    manager.MoveRelative(id, {dx, 0});
+  });
+}
+
+/** @brief 不透明度を乗算済みのピクセルの並びを描画先と重ねる */
+Result BlendSpanScene() {
+  Desktop desktop;
+  auto &writer = desktop.Screen().BackBuffer().Writer();
+  std::vector<uint32_t> span(256);
+  for (int x = 0; x < 256; ++x) {
+    // 不透明度 x で色 (r, g, b) = (0xff, 0x80, 0x40) を乗算した値
+    const uint32_t a = x;
+    span[x] = a << 24 | (0xff * a / 255) << 16 | (0x80 * a / 255) << 8 |
+              (0x40 * a / 255);
+  }
+  return MeasurePrimitive(20000, 256 * 256, [&](unsigned long i) {
+    for (int y = 0; y < 256; ++y) {
+      writer.BlendSpan({static_cast<int>(i % 512), 100 + y}, span.data(), 256,
+                       kPixelFormat);
+    }
+  });
+}
+
+struct Scene {
+  const char *name;
+  Result (*run)();
+};
+
+const Scene kScenes[] = {
+    {"cursor-move", CursorMove},
+    {"console-scroll", ConsoleScroll},
+    {"many-window", ManyWindow},
+    {"layer-churn", LayerChurn},
+    {"full-redraw", FullRedraw},
+    {"fill-rect", FillRectangleScene},
+    {"write-string", WriteStringScene},
+    {"window-drawto", WindowDrawToScene},
+    {"fb-copy", FrameBufferCopyScene},
+    {"raster", RasterScene},
+    {"layer-alpha", LayerAlphaScene},
+    {"blend-span", BlendSpanScene},
+};
+} // namespace
+// scenes
+
+int main(int argc, char **argv) {
+  InitializeBlitKernel();
+
+  PrintHeader();
+  for (const auto &scene : kScenes) {
+    bool selected = argc <= 1;
+    for (int i = 1; i < argc; ++i) {
+      selected |= strcmp(argv[i], scene.name) == 0;
+    }
+    if (selected) {
+      PrintResult(scene.name, scene.run());
+    }
+  }
+  return 0;
+}
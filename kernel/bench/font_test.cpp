@@ -0,0 +1,103 @@
+/**
+ * @file bench/font_test.cpp
+ *
+ * UTF-8 として正しくないバイトの描き方を確かめる。全角フォントには
+ * U+0080 と U+00E9 だけを持つ test_font.hex を埋め込み，正しくないバイトが
+ * 全角フォントではなく hankaku で描かれることを調べる。
+ * 全角フォントのページを展開した回数も数え，正しくないバイトでは
+ * 全角フォントを引かないことと，展開したページを使い回すことを確かめる。
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "font.hpp"
+#include "frame_buffer.hpp"
+#include "zenkaku_font.hpp"
+
+namespace {
+const int kWidth = 64, kHeight = 16;
+const PixelColor kFG{255, 255, 255}, kBG{0, 0, 0};
+int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);          \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+std::vector<uint32_t> Pixels(FrameBuffer &fb) {
+  const auto &config = fb.Config();
+  const auto p = reinterpret_cast<const uint32_t *>(config.frame_buffer);
+  return {p, p + config.pixels_per_scan_line * config.vertical_resolution};
+}
+
+/** @brief s を WriteString で描いた結果を返す */
+std::vector<uint32_t> RenderString(const char *s) {
+  FrameBuffer fb;
+  fb.Initialize({nullptr, kWidth, kWidth, kHeight, kPixelBGRResv8BitPerColor});
+  FillRectangle(fb.Writer(), {0, 0}, {kWidth, kHeight}, kBG);
+  WriteString(fb.Writer(), {0, 0}, s, kFG, kBG);
+  return Pixels(fb);
+}
+
+/** @brief バイト c を hankaku で描いた結果を返す */
+std::vector<uint32_t> RenderAscii(char c) {
+  FrameBuffer fb;
+  fb.Initialize({nullptr, kWidth, kWidth, kHeight, kPixelBGRResv8BitPerColor});
+  FillRectangle(fb.Writer(), {0, 0}, {kWidth, kHeight}, kBG);
+  WriteAscii(fb.Writer(), {0, 0}, c, kFG, kBG);
+  return Pixels(fb);
+}
+
+/** @brief 左端から幅 16 の範囲が全角フォントの四角で塗られていれば true */
+bool IsWideBlock(const std::vector<uint32_t> &pixels) {
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < 16; ++x) {
+      if (pixels[kWidth * y + x] != 0xffffff) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+} // namespace
+
+int main() {
+  char32_t c;
+  CHECK(DecodeUTF8("\xe9", c) == 1 && c == 0xe9);
+  CHECK(DecodeUTF8("\x80", c) == 1 && c == 0x80);
+  CHECK(DecodeUTF8("\xc3\xa9", c) == 2 && c == 0xe9);
+  // 冗長な表現は正しくないバイトとして扱う
+  CHECK(DecodeUTF8("\xc1\xa9", c) == 1 && c == 0xc1);
+  // サロゲートと U+10FFFF を超える値も同じく扱う
+  CHECK(DecodeUTF8("\xed\xa0\x80", c) == 1 && c == 0xed);
+  CHECK(DecodeUTF8("\xed\xbf\xbf", c) == 1 && c == 0xed);
+  CHECK(DecodeUTF8("\xf4\x90\x80\x80", c) == 1 && c == 0xf4);
+  CHECK(DecodeUTF8("\xf7\xbf\xbf\xbf", c) == 1 && c == 0xf7);
+  // 境界のすぐ外側は正しい文字として読む
+  CHECK(DecodeUTF8("\xed\x9f\xbf", c) == 3 && c == 0xd7ff);
+  CHECK(DecodeUTF8("\xee\x80\x80", c) == 3 && c == 0xe000);
+  CHECK(DecodeUTF8("\xf4\x8f\xbf\xbf", c) == 4 && c == 0x10ffff);
+
+  // 単独の 0xE9 や 0x80 は全角フォントを引かずに hankaku で描く
+  CHECK(RenderString("\xe9") == RenderAscii('\xe9'));
+  CHECK(RenderString("\x80") == RenderAscii('\x80'));
+  CHECK(!IsWideBlock(RenderString("\xe9")));
+  CHECK(ZenkakuPageLoads() == 0);
+
+  // 正しい UTF-8 の U+00E9 は全角フォントで描く。2回目は展開済みのページを使う
+  CHECK(IsWideBlock(RenderString("\xc3\xa9")));
+  CHECK(ZenkakuPageLoads() == 1);
+  CHECK(IsWideBlock(RenderString("\xc2\x80")));
+  CHECK(ZenkakuPageLoads() == 1);
+
+  if (failures > 0) {
+    printf("font_test: %d failure(s)\n", failures);
+    return 1;
+  }
+  printf("font_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file bench/raster_test.cpp
+ *
+ * 円弧が指定した角度の範囲のピクセルだけを描くことを確かめる。
+ * 円周のピクセルを DrawCircle で求め，中心から見た向きを atan2 で測って
+ * DrawArc が描いたピクセルと比べる。
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "raster.hpp"
+
+namespace {
+const int kSize = 128;
+const Vector2D<int> kCenter{64, 64};
+const int kRadius = 50;
+/** @brief 境界の判定で許す誤差（度） */
+const double kTolerance = 0.05;
+int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);          \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+/** @brief 書き込まれたピクセルに印を付けるだけの PixelWriter */
+class Canvas : public PixelWriter {
+public:
+  Canvas() : marks_(kSize * kSize) {}
+  virtual void Write(Vector2D<int> pos, const PixelColor &c) override {
+    marks_[kSize * pos.y + pos.x] = true;
+  }
+  virtual int Width() const override { return kSize; }
+  virtual int Height() const override { return kSize; }
+
+  bool At(int x, int y) const { return marks_[kSize * y + x]; }
+
+private:
+  std::vector<bool> marks_;
+};
+
+/** @brief 中心から (x, y) の向きを，x 軸の正の向きから時計回りに測って
+ * [0, 360) の度数で返す */
+double AngleOf(int x, int y) {
+  const double a = std::atan2(y - kCenter.y, x - kCenter.x) * 180 / M_PI;
+  return a < 0 ? a + 360 : a;
+}
+
+/** @brief angle が begin から時計回りに sweep 度の範囲にあるかを，
+ * 境界から kTolerance 以上離れている場合だけ判定する
+ *
+ * @return 内側なら 1，外側なら 0，境界に近ければ -1
+ */
+int Classify(double angle, double begin, double sweep) {
+  const double d = std::fmod(angle - begin + 720, 360);
+  if (d < kTolerance || std::fabs(d - sweep) < kTolerance ||
+      d > 360 - kTolerance) {
+    return -1;
+  }
+  return d < sweep ? 1 : 0;
+}
+
+/** @brief DrawArc が円周のうち範囲内のピクセルだけを描くかを調べ，
+ * 描いたピクセルの数を返す */
+int CheckArc(int start_angle, int end_angle) {
+  Canvas circle, arc;
+  DrawCircle(circle, kCenter, kRadius, {});
+  DrawArc(arc, kCenter, kRadius, start_angle, end_angle, {});
+  const double sweep = std::fmod(end_angle - start_angle + 720, 360);
+  int drawn = 0, wrong = 0;
+  for (int y = 0; y < kSize; ++y) {
+    for (int x = 0; x < kSize; ++x) {
+      drawn += arc.At(x, y);
+      if (arc.At(x, y) && !circle.At(x, y)) {
+        ++wrong;
+        continue;
+      }
+      const int inside = Classify(AngleOf(x, y), start_angle, sweep);
+      if (circle.At(x, y) && inside >= 0 && arc.At(x, y) != (inside == 1)) {
+        ++wrong;
+      }
+    }
+  }
+  if (wrong > 0) {
+    printf("arc %d-%d: %d pixel(s) differ\n", start_angle, end_angle, wrong);
+  }
+  CHECK(wrong == 0);
+  return drawn;
+}
+
+int CountPixels(const Canvas &canvas) {
+  int n = 0;
+  for (int y = 0; y < kSize; ++y) {
+    for (int x = 0; x < kSize; ++x) {
+      n += canvas.At(x, y);
+    }
+  }
+  return n;
+}
+} // namespace
+
+int main() {
+  Canvas circle;
+  DrawCircle(circle, kCenter, kRadius, {});
+  const int circumference = CountPixels(circle);
+
+  // 10 度の幅の円弧は円周の 1/36 程度しか描かない
+  const int narrow = CheckArc(10, 20);
+  CHECK(narrow > 0 && narrow < circumference / 36 + 4);
+  CheckArc(0, 50);
+  CheckArc(100, 280);
+  CheckArc(30, 300);
+  // 0 度をまたぐ範囲と負の角度
+  CheckArc(350, 10);
+  CheckArc(-45, 45);
+
+  Canvas full, empty;
+  DrawArc(full, kCenter, kRadius, 100, 460, {});
+  DrawArc(empty, kCenter, kRadius, 30, 30, {});
+  CHECK(CountPixels(full) == circumference);
+  CHECK(CountPixels(empty) == 0);
+
+  if (failures > 0) {
+    printf("raster_test: %d failure(s)\n", failures);
+    return 1;
+  }
+  printf("raster_test: ok\n");
+  return 0;
+}
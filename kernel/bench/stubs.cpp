@@ -0,0 +1,81 @@
+/**
+ * @file bench/stubs.cpp
+ *
+ * ベンチマークに含めないカーネルの関数をホスト上で置き換える。
+ */
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "asmfunc.h"
+#include "logger.hpp"
+#include "memory_manager.hpp"
+#include "timer.hpp"
+
+// logger
+namespace {
+LogLevel log_level = kWarn;
+}
+
+void SetLogLevel(LogLevel level) { log_level = level; }
+
+LogLevel GetLogLevel() { return log_level; }
+
+int Log(LogLevel level, const char *format, ...) {
+  if (level > log_level) {
+    return 0;
+  }
+  va_list ap;
+  va_start(ap, format);
+  const int result = vfprintf(stderr, format, ap);
+  va_end(ap);
+  return result;
+}
+// logger
+
+// asmfunc
+// ユーザーモードでは CR4 を読み書きできない。
+// Linux は OSXSAVE を有効にしているので，InitializeBlitKernel は XCR0 を読むだけ
+extern "C" {
+uint64_t GetCR4(void) { return 0; }
+
+void SetCR4(uint64_t value) {}
+
+uint64_t GetXCR0(void) {
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+void SetXCR0(uint64_t value) {}
+
+uint64_t ReadTSC(void) {
+  uint32_t eax, edx;
+  __asm__ volatile("rdtsc" : "=a"(eax), "=d"(edx));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+}
+// asmfunc
+
+// timer
+// TSC の周波数は測らない。計測には std::chrono を使う
+uint64_t TSCToNanoseconds(uint64_t tsc_count) { return 0; }
+// timer
+
+// large_buffer
+WithError<uint8_t *> AllocateLargeBuffer(size_t bytes) {
+  const size_t aligned_bytes = (bytes + kLargeBufferAlignment - 1) /
+                               kLargeBufferAlignment * kLargeBufferAlignment;
+  auto buffer = static_cast<uint8_t *>(
+      aligned_alloc(kLargeBufferAlignment, aligned_bytes));
+  if (buffer == nullptr) {
+    return {nullptr, MAKE_ERROR(Error::kNoEnoughMemory)};
+  }
+  return {buffer, MAKE_ERROR(Error::kSuccess)};
+}
+
+void FreeLargeBuffer(uint8_t *buffer, size_t bytes) { free(buffer); }
+// large_buffer
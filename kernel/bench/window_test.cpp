@@ -0,0 +1,105 @@
+/**
+ * @file bench/window_test.cpp
+ *
+ * パレット番号で内容を持つウィンドウを確かめる。使う色が 256 色を超えると
+ * 描画先と同じ形式の持ち方に切り替わり，それまでの内容が保たれることを調べる。
+ * ピクセルごとの不透明度が内容と一緒に送られ，重ねる際に使われることも調べる。
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "frame_buffer.hpp"
+#include "window.hpp"
+
+namespace {
+const int kWidth = 32, kHeight = 16;
+const PixelFormat kPixelFormat = kPixelBGRResv8BitPerColor;
+int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);          \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+/** @brief 番号 i ごとに異なる色を返す */
+PixelColor ColorOf(int i) {
+  return {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 0x40};
+}
+
+/** @brief window をフレームバッファに描き，そのピクセルの並びを返す */
+std::vector<uint32_t> Render(Window &window) {
+  FrameBuffer fb;
+  fb.Initialize({nullptr, kWidth, kWidth, kHeight, kPixelFormat});
+  window.DrawTo(fb, {0, 0}, {{0, 0}, {kWidth, kHeight}});
+  const auto p = reinterpret_cast<const uint32_t *>(fb.Config().frame_buffer);
+  return {p, p + kWidth * kHeight};
+}
+} // namespace
+
+int main() {
+  Window indexed(kWidth, kHeight, kPixelFormat, Window::Surface::kIndexed);
+  Window direct(kWidth, kHeight, kPixelFormat);
+  CHECK(indexed.SurfaceType() == Window::Surface::kIndexed);
+  CHECK(direct.SurfaceType() == Window::Surface::kDirect);
+  // 初期状態の黒だけがパレットに入っている
+  CHECK(indexed.PaletteSize() == 1);
+
+  // 256 色までは番号のまま持つ。同じ色は新しく登録しない
+  for (int i = 0; i < 255; ++i) {
+    indexed.Write({i % kWidth, i / kWidth}, ColorOf(i + 1));
+    direct.Write({i % kWidth, i / kWidth}, ColorOf(i + 1));
+  }
+  indexed.FillRect({{0, 10}, {kWidth, 2}}, ColorOf(1));
+  direct.FillRect({{0, 10}, {kWidth, 2}}, ColorOf(1));
+  CHECK(indexed.SurfaceType() == Window::Surface::kIndexed);
+  CHECK(indexed.PaletteSize() == 256);
+  CHECK(Render(indexed) == Render(direct));
+
+  // 257 色目で切り替わり，それまでの内容はそのまま残る
+  indexed.Write({0, 12}, ColorOf(1000));
+  direct.Write({0, 12}, ColorOf(1000));
+  CHECK(indexed.SurfaceType() == Window::Surface::kDirect);
+  CHECK(indexed.At({0, 12}) == ColorOf(1000));
+  CHECK(indexed.At({254 % kWidth, 254 / kWidth}) == ColorOf(255));
+  CHECK(Render(indexed) == Render(direct));
+
+  // ピクセルごとの不透明度は FillAlpha を呼ぶまで持たない
+  Window translucent(kWidth, kHeight, kPixelFormat);
+  translucent.FillRect({{0, 0}, {kWidth, kHeight}}, ColorOf(1));
+  CHECK(!translucent.HasAlpha());
+  CHECK(translucent.AlphaAt({0, 0}) == 255);
+  translucent.FillAlpha({{0, 0}, {kWidth, 4}}, 0);
+  CHECK(translucent.HasAlpha());
+  CHECK(translucent.AlphaAt({kWidth - 1, 3}) == 0);
+  CHECK(translucent.AlphaAt({0, 4}) == 255);
+
+  // 不透明度は行と一緒に送られる
+  translucent.Scroll(2);
+  CHECK(translucent.AlphaAt({0, 1}) == 0);
+  CHECK(translucent.AlphaAt({0, 2}) == 255);
+  translucent.Move({0, 8}, {{0, 0}, {kWidth, 2}});
+  CHECK(translucent.AlphaAt({0, 9}) == 0);
+  CHECK(translucent.AlphaAt({0, 10}) == 255);
+
+  // 不透明度 0 のピクセルは描画先をそのまま残す
+  FrameBuffer fb;
+  fb.Initialize({nullptr, kWidth, kWidth, kHeight, kPixelFormat});
+  FillRectangle(fb.Writer(), {0, 0}, {kWidth, kHeight}, ColorOf(2));
+  translucent.DrawTo(fb, {0, 0}, {{0, 0}, {kWidth, kHeight}});
+  const auto pixels =
+      reinterpret_cast<const uint32_t *>(fb.Config().frame_buffer);
+  CHECK(pixels[kWidth * 0] == ToNativePixel(kPixelFormat, ColorOf(2)));
+  CHECK(pixels[kWidth * 9] == ToNativePixel(kPixelFormat, ColorOf(2)));
+  CHECK(pixels[kWidth * 2] == ToNativePixel(kPixelFormat, ColorOf(1)));
+
+  if (failures > 0) {
+    printf("window_test: %d failure(s)\n", failures);
+    return 1;
+  }
+  printf("window_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,550 @@
+#include "blit.hpp"
+
+#include <algorithm>
+#include <cpuid.h>
+#include <cstring>
+#include <immintrin.h>
+#include <vector>
+
+#include "asmfunc.h"
+#include "logger.hpp"
+#include "timer.hpp"
+
+namespace {
+// generic
+void GenericCopy(void *dst, const void *src, size_t bytes) {
+  memcpy(dst, src, bytes);
+}
+
+void GenericMove(void *dst, const void *src, size_t bytes) {
+  memmove(dst, src, bytes);
+}
+
+void GenericFill32(void *dst, uint32_t value, size_t count) {
+  auto p = reinterpret_cast<uint32_t *>(dst);
+  for (size_t i = 0; i < count; ++i) {
+    p[i] = value;
+  }
+}
+
+/** @brief 0 から 255 * 255 までの値を 255 で割って四捨五入する */
+inline uint32_t Div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+void GenericBlend32(void *dst, const void *src, const uint8_t *mask,
+                    size_t count, uint8_t alpha) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < count; ++i, d += 4, s += 4) {
+    const uint32_t a = mask ? Div255(mask[i] * alpha) : alpha;
+    for (int c = 0; c < 4; ++c) {
+      d[c] = Div255(s[c] * a + d[c] * (255 - a));
+    }
+  }
+}
+
+void GenericBlendPremultiplied32(void *dst, const void *src, size_t count) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < count; ++i, d += 4, s += 4) {
+    const uint32_t inv_alpha = 255 - s[3];
+    for (int c = 0; c < 3; ++c) {
+      d[c] = std::min<uint32_t>(s[c] + Div255(d[c] * inv_alpha), 255);
+    }
+    d[3] = 0;
+  }
+}
+// generic
+
+/** @brief dst が src より後ろにあり，かつ領域が重なっている場合に true を返す
+ * このときは後ろからコピーしないと未読のデータを上書きしてしまう */
+bool NeedsBackwardCopy(void *dst, const void *src, size_t bytes) {
+  const auto d = reinterpret_cast<uintptr_t>(dst);
+  const auto s = reinterpret_cast<uintptr_t>(src);
+  return s < d && d < s + bytes;
+}
+
+// erms
+void ErmsCopy(void *dst, const void *src, size_t bytes) {
+  __asm__ volatile("rep movsb"
+                   : "+D"(dst), "+S"(src), "+c"(bytes)
+                   :
+                   : "memory");
+}
+
+void ErmsMove(void *dst, const void *src, size_t bytes) {
+  if (NeedsBackwardCopy(dst, src, bytes)) {
+    // DF=1 の rep movsb は高速化の対象外なので通常の memmove に任せる
+    memmove(dst, src, bytes);
+    return;
+  }
+  ErmsCopy(dst, src, bytes);
+}
+
+void ErmsFill32(void *dst, uint32_t value, size_t count) {
+  __asm__ volatile("rep stosl"
+                   : "+D"(dst), "+c"(count)
+                   : "a"(value)
+                   : "memory");
+}
+// erms
+
+// sse2
+void Sse2CopyForward(uint8_t *d, const uint8_t *s, size_t bytes) {
+  // 4ブロック分を読み込んでから書き込むので，d < s で重なっていても正しく動く
+  for (; bytes >= 64; bytes -= 64, d += 64, s += 64) {
+    const auto x0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+    const auto x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+    const auto x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 32));
+    const auto x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 48));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d), x0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + 16), x1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + 32), x2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + 48), x3);
+  }
+  for (; bytes >= 16; bytes -= 16, d += 16, s += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                     _mm_loadu_si128(reinterpret_cast<const __m128i *>(s)));
+  }
+  for (; bytes > 0; --bytes) {
+    *d++ = *s++;
+  }
+}
+
+void Sse2CopyBackward(uint8_t *d, const uint8_t *s, size_t bytes) {
+  for (; bytes >= 64; bytes -= 64) {
+    const auto x0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + bytes - 16));
+    const auto x1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + bytes - 32));
+    const auto x2 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + bytes - 48));
+    const auto x3 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + bytes - 64));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + bytes - 16), x0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + bytes - 32), x1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + bytes - 48), x2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + bytes - 64), x3);
+  }
+  for (; bytes >= 16; bytes -= 16) {
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(d + bytes - 16),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + bytes - 16)));
+  }
+  for (; bytes > 0; --bytes) {
+    d[bytes - 1] = s[bytes - 1];
+  }
+}
+
+void Sse2Copy(void *dst, const void *src, size_t bytes) {
+  Sse2CopyForward(reinterpret_cast<uint8_t *>(dst),
+                  reinterpret_cast<const uint8_t *>(src), bytes);
+}
+
+void Sse2Move(void *dst, const void *src, size_t bytes) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  if (NeedsBackwardCopy(dst, src, bytes)) {
+    Sse2CopyBackward(d, s, bytes);
+  } else {
+    Sse2CopyForward(d, s, bytes);
+  }
+}
+
+void Sse2Fill32(void *dst, uint32_t value, size_t count) {
+  auto p = reinterpret_cast<uint32_t *>(dst);
+  const auto x = _mm_set1_epi32(value);
+  for (; count >= 16; count -= 16, p += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), x);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 4), x);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 8), x);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 12), x);
+  }
+  for (; count >= 4; count -= 4, p += 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), x);
+  }
+  for (; count > 0; --count) {
+    *p++ = value;
+  }
+}
+
+/** @brief 16 ビットの各要素を 255 で割って四捨五入する */
+__m128i Sse2Div255(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/** @brief 16 ビットに広げた2ピクセル分のチャンネルを不透明度 a で重ねる */
+__m128i Sse2BlendChannels(__m128i s, __m128i d, __m128i a) {
+  const auto inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+  return Sse2Div255(
+      _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, inv)));
+}
+
+void Sse2Blend32(void *dst, const void *src, const uint8_t *mask,
+                 size_t count, uint8_t alpha) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  const auto zero = _mm_setzero_si128();
+  const auto global_alpha = _mm_set1_epi16(alpha);
+  // 1回に4ピクセルずつ，2ピクセルごとに 16 ビットへ広げて計算する
+  for (; count >= 4; count -= 4, d += 16, s += 16) {
+    auto a_lo = global_alpha, a_hi = global_alpha;
+    if (mask) {
+      uint32_t m4;
+      memcpy(&m4, mask, 4);
+      mask += 4;
+      auto m = _mm_unpacklo_epi8(_mm_cvtsi32_si128(m4), zero);
+      m = Sse2Div255(_mm_mullo_epi16(m, global_alpha));
+      m = _mm_unpacklo_epi16(m, m);
+      a_lo = _mm_unpacklo_epi32(m, m);
+      a_hi = _mm_unpackhi_epi32(m, m);
+    }
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+    const auto y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(d));
+    const auto lo = Sse2BlendChannels(_mm_unpacklo_epi8(x, zero),
+                                      _mm_unpacklo_epi8(y, zero), a_lo);
+    const auto hi = Sse2BlendChannels(_mm_unpackhi_epi8(x, zero),
+                                      _mm_unpackhi_epi8(y, zero), a_hi);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm_packus_epi16(lo, hi));
+  }
+  GenericBlend32(d, s, mask, count, alpha);
+}
+
+/** @brief 16 ビットに広げた2ピクセル分の乗算済みのチャンネルを重ねる */
+__m128i Sse2BlendPremultipliedChannels(__m128i s, __m128i d) {
+  // 各ピクセルの不透明度（4 番目のチャンネル）を全チャンネルに行き渡らせる
+  const auto a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+  const auto inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+  return _mm_add_epi16(s, Sse2Div255(_mm_mullo_epi16(d, inv)));
+}
+
+void Sse2BlendPremultiplied32(void *dst, const void *src, size_t count) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  const auto zero = _mm_setzero_si128();
+  const auto color_mask = _mm_set1_epi32(0x00ffffff);
+  for (; count >= 4; count -= 4, d += 16, s += 16) {
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+    const auto y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(d));
+    const auto lo = Sse2BlendPremultipliedChannels(_mm_unpacklo_epi8(x, zero),
+                                                   _mm_unpacklo_epi8(y, zero));
+    const auto hi = Sse2BlendPremultipliedChannels(_mm_unpackhi_epi8(x, zero),
+                                                   _mm_unpackhi_epi8(y, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                     _mm_and_si128(_mm_packus_epi16(lo, hi), color_mask));
+  }
+  GenericBlendPremultiplied32(d, s, count);
+}
+// sse2
+
+// avx2
+__attribute__((target("avx2"))) void
+Avx2CopyForward(uint8_t *d, const uint8_t *s, size_t bytes) {
+  for (; bytes >= 128; bytes -= 128, d += 128, s += 128) {
+    const auto y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+    const auto y1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32));
+    const auto y2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 64));
+    const auto y3 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 96));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), y0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 32), y1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 64), y2);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 96), y3);
+  }
+  for (; bytes >= 32; bytes -= 32, d += 32, s += 32) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(d),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)));
+  }
+  for (; bytes > 0; --bytes) {
+    *d++ = *s++;
+  }
+}
+
+__attribute__((target("avx2"))) void
+Avx2CopyBackward(uint8_t *d, const uint8_t *s, size_t bytes) {
+  for (; bytes >= 128; bytes -= 128) {
+    const auto y0 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(s + bytes - 32));
+    const auto y1 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(s + bytes - 64));
+    const auto y2 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(s + bytes - 96));
+    const auto y3 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(s + bytes - 128));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + bytes - 32), y0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + bytes - 64), y1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + bytes - 96), y2);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + bytes - 128), y3);
+  }
+  for (; bytes >= 32; bytes -= 32) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(d + bytes - 32),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + bytes - 32)));
+  }
+  for (; bytes > 0; --bytes) {
+    d[bytes - 1] = s[bytes - 1];
+  }
+}
+
+__attribute__((target("avx2"))) void Avx2Copy(void *dst, const void *src,
+                                              size_t bytes) {
+  Avx2CopyForward(reinterpret_cast<uint8_t *>(dst),
+                  reinterpret_cast<const uint8_t *>(src), bytes);
+}
+
+__attribute__((target("avx2"))) void Avx2Move(void *dst, const void *src,
+                                              size_t bytes) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  if (NeedsBackwardCopy(dst, src, bytes)) {
+    Avx2CopyBackward(d, s, bytes);
+  } else {
+    Avx2CopyForward(d, s, bytes);
+  }
+}
+
+__attribute__((target("avx2"))) void Avx2Fill32(void *dst, uint32_t value,
+                                                size_t count) {
+  auto p = reinterpret_cast<uint32_t *>(dst);
+  const auto y = _mm256_set1_epi32(value);
+  for (; count >= 32; count -= 32, p += 32) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), y);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + 8), y);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + 16), y);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + 24), y);
+  }
+  for (; count >= 8; count -= 8, p += 8) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), y);
+  }
+  for (; count > 0; --count) {
+    *p++ = value;
+  }
+}
+
+__attribute__((target("avx2"))) __m256i Avx2Div255(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("avx2"))) __m256i
+Avx2BlendChannels(__m256i s, __m256i d, __m256i a) {
+  const auto inv = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+  return Avx2Div255(
+      _mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, inv)));
+}
+
+__attribute__((target("avx2"))) void Avx2Blend32(void *dst, const void *src,
+                                                 const uint8_t *mask,
+                                                 size_t count, uint8_t alpha) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  const auto zero = _mm256_setzero_si256();
+  const auto global_alpha = _mm256_set1_epi16(alpha);
+  // 1回に8ピクセルずつ処理する。unpack は 128 ビットの半分ごとに働くので，
+  // lo は 0, 1, 4, 5 番目，hi は 2, 3, 6, 7 番目のピクセルになる
+  for (; count >= 8; count -= 8, d += 32, s += 32) {
+    auto a_lo = global_alpha, a_hi = global_alpha;
+    if (mask) {
+      auto m = _mm_unpacklo_epi8(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i *>(mask)),
+          _mm_setzero_si128());
+      mask += 8;
+      m = Sse2Div255(_mm_mullo_epi16(m, _mm_set1_epi16(alpha)));
+      const auto m03 = _mm_unpacklo_epi16(m, m);
+      const auto m47 = _mm_unpackhi_epi16(m, m);
+      const auto m07 =
+          _mm256_inserti128_si256(_mm256_castsi128_si256(m03), m47, 1);
+      a_lo = _mm256_unpacklo_epi32(m07, m07);
+      a_hi = _mm256_unpackhi_epi32(m07, m07);
+    }
+    const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+    const auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(d));
+    const auto lo = Avx2BlendChannels(_mm256_unpacklo_epi8(x, zero),
+                                      _mm256_unpacklo_epi8(y, zero), a_lo);
+    const auto hi = Avx2BlendChannels(_mm256_unpackhi_epi8(x, zero),
+                                      _mm256_unpackhi_epi8(y, zero), a_hi);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d),
+                        _mm256_packus_epi16(lo, hi));
+  }
+  Sse2Blend32(d, s, mask, count, alpha);
+}
+
+__attribute__((target("avx2"))) __m256i
+Avx2BlendPremultipliedChannels(__m256i s, __m256i d) {
+  const auto a =
+      _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xff), 0xff);
+  const auto inv = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+  return _mm256_add_epi16(s, Avx2Div255(_mm256_mullo_epi16(d, inv)));
+}
+
+__attribute__((target("avx2"))) void
+Avx2BlendPremultiplied32(void *dst, const void *src, size_t count) {
+  auto d = reinterpret_cast<uint8_t *>(dst);
+  auto s = reinterpret_cast<const uint8_t *>(src);
+  const auto zero = _mm256_setzero_si256();
+  const auto color_mask = _mm256_set1_epi32(0x00ffffff);
+  for (; count >= 8; count -= 8, d += 32, s += 32) {
+    const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+    const auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(d));
+    const auto lo = Avx2BlendPremultipliedChannels(
+        _mm256_unpacklo_epi8(x, zero), _mm256_unpacklo_epi8(y, zero));
+    const auto hi = Avx2BlendPremultipliedChannels(
+        _mm256_unpackhi_epi8(x, zero), _mm256_unpackhi_epi8(y, zero));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(d),
+        _mm256_and_si256(_mm256_packus_epi16(lo, hi), color_mask));
+  }
+  Sse2BlendPremultiplied32(d, s, count);
+}
+// avx2
+
+// kernels
+enum KernelIndex {
+  kGeneric,
+  kErms,
+  kSse2,
+  kAvx2,
+  kNumKernels,
+};
+
+const BlitKernel kernels[kNumKernels] = {
+    {"generic", GenericCopy, GenericMove, GenericFill32, GenericBlend32,
+     GenericBlendPremultiplied32},
+    // 合成は x86-64 なら必ず使える SSE2 で行う
+    {"erms", ErmsCopy, ErmsMove, ErmsFill32, Sse2Blend32,
+     Sse2BlendPremultiplied32},
+    {"sse2", Sse2Copy, Sse2Move, Sse2Fill32, Sse2Blend32,
+     Sse2BlendPremultiplied32},
+    {"avx2", Avx2Copy, Avx2Move, Avx2Fill32, Avx2Blend32,
+     Avx2BlendPremultiplied32},
+};
+
+/** @brief kernels の各要素がこの CPU で使えるかどうか */
+bool kernel_supported[kNumKernels] = {true, false, false, false};
+// kernels
+
+// cpu_features
+/** @brief AVX のレジスタを OS が保存・復元する設定になっていなければ有効にする
+ *
+ * @return AVX 命令を使える状態になれば true
+ */
+bool EnableAVX(unsigned int cpuid1_ecx) {
+  if ((cpuid1_ecx & bit_AVX) == 0 || (cpuid1_ecx & bit_XSAVE) == 0) {
+    return false;
+  }
+  if ((cpuid1_ecx & bit_OSXSAVE) == 0) {
+    SetCR4(GetCR4() | (1u << 18)); // CR4.OSXSAVE
+  }
+  const uint64_t xcr0 = GetXCR0();
+  if ((xcr0 & 0b110) != 0b110) {
+    SetXCR0(xcr0 | 0b111); // x87, SSE, AVX
+  }
+  return true;
+}
+
+void DetectCPUFeatures() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return;
+  }
+  kernel_supported[kSse2] = (edx & bit_SSE2) != 0;
+  const bool avx = EnableAVX(ecx);
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return;
+  }
+  kernel_supported[kErms] = (ebx & (1u << 9)) != 0;
+  kernel_supported[kAvx2] = avx && (ebx & bit_AVX2) != 0;
+}
+// cpu_features
+} // namespace
+
+const BlitKernel *blit_kernel = &kernels[kGeneric];
+
+// initialize_blit_kernel
+void InitializeBlitKernel() {
+  DetectCPUFeatures();
+
+  // 画面の1行は数百バイトから数キロバイトなので，立ち上がりの遅い rep movsb より
+  // SIMD 命令の実装を優先する
+  for (auto index : {kAvx2, kSse2, kErms}) {
+    if (kernel_supported[index]) {
+      blit_kernel = &kernels[index];
+      return;
+    }
+  }
+}
+// initialize_blit_kernel
+
+// benchmark_blit_kernels
+void BenchmarkBlitKernels() {
+  const struct {
+    int width, height;
+  } sizes[] = {
+      {15, 24},   // マウスカーソル
+      {160, 52},  // 小さなウィンドウ
+      {640, 400}, // コンソール
+      {1024, 768},
+  };
+  const int kIterations = 4;
+
+  for (const auto &size : sizes) {
+    const size_t pixels = size.width * size.height;
+    const size_t row_bytes = 4 * size.width;
+    std::vector<uint32_t> src(pixels, 0x00c6c6c6), dst(pixels);
+
+    for (int i = 0; i < kNumKernels; ++i) {
+      if (!kernel_supported[i]) {
+        continue;
+      }
+      const auto &kernel = kernels[i];
+
+      auto start = ReadTSC();
+      for (int n = 0; n < kIterations; ++n) {
+        for (int y = 0; y < size.height; ++y) {
+          kernel.copy(&dst[y * size.width], &src[y * size.width], row_bytes);
+        }
+      }
+      const auto copy_elapsed = TSCToNanoseconds(ReadTSC() - start);
+
+      // 1ピクセル右へずらす，重なりのある移動
+      start = ReadTSC();
+      for (int n = 0; n < kIterations; ++n) {
+        for (int y = 0; y < size.height; ++y) {
+          kernel.move(&dst[y * size.width + 1], &dst[y * size.width],
+                      row_bytes - 4);
+        }
+      }
+      const auto move_elapsed = TSCToNanoseconds(ReadTSC() - start);
+
+      start = ReadTSC();
+      for (int n = 0; n < kIterations; ++n) {
+        for (int y = 0; y < size.height; ++y) {
+          kernel.fill32(&dst[y * size.width], 0x00000084, size.width);
+        }
+      }
+      const auto fill_elapsed = TSCToNanoseconds(ReadTSC() - start);
+
+      start = ReadTSC();
+      for (int n = 0; n < kIterations; ++n) {
+        for (int y = 0; y < size.height; ++y) {
+          kernel.blend32(&dst[y * size.width], &src[y * size.width], nullptr,
+                         size.width, 0x80);
+        }
+      }
+      const auto blend_elapsed = TSCToNanoseconds(ReadTSC() - start);
+
+      Log(kDebug,
+          "blit %4dx%-4d %-7s copy %9lu move %9lu fill %9lu blend %9lu ns%s\n",
+          size.width, size.height, kernel.name, copy_elapsed, move_elapsed,
+          fill_elapsed, blend_elapsed, &kernel == blit_kernel ? " *" : "");
+    }
+  }
+}
+// benchmark_blit_kernels
@@ -0,0 +1,88 @@
+/**
+ * @file blit.hpp
+ *
+ * フレームバッファ間のコピーや塗りつぶしに使う基本処理を提供する。
+ * CPU の機能に応じて SSE2，AVX2，rep movsb (ERMS) を使う実装から
+ * 起動時に1つを選択する。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/** @brief 画面描画で使うメモリ操作の実装の組 */
+struct BlitKernel {
+  /** @brief 実装の名前（計測結果の表示用） */
+  const char *name;
+  /** @brief src から dst へ bytes バイトコピーする。領域は重なってはいけない */
+  void (*copy)(void *dst, const void *src, size_t bytes);
+  /** @brief src から dst へ bytes バイトコピーする。領域が重なってもよい */
+  void (*move)(void *dst, const void *src, size_t bytes);
+  /** @brief dst から count 個の 32 ビット値 value を書き込む */
+  void (*fill32)(void *dst, uint32_t value, size_t count);
+  /** @brief src の count 個のピクセルを不透明度 alpha で dst に重ねる
+   *
+   * 各チャンネルを (src * a + dst * (255 - a)) / 255 とする。
+   * mask が nullptr でなければピクセルごとの不透明度 mask[i] を掛け合わせ，
+   * a = mask[i] * alpha / 255 とする。どの実装でも結果は同じになる
+   */
+  void (*blend32)(void *dst, const void *src, const uint8_t *mask,
+                  size_t count, uint8_t alpha);
+  /** @brief 不透明度を乗算済みの src の count 個のピクセルを dst に重ねる
+   *
+   * src の上位 8 ビットを不透明度 a として，下位 24 ビットの各チャンネルを
+   * src + dst * (255 - a) / 255 とし，上位 8 ビットは 0 にする。
+   * BlendPremultiplied と同じ結果になる
+   */
+  void (*blend_premultiplied32)(void *dst, const void *src, size_t count);
+};
+
+/** @brief 現在選択されている実装
+ *
+ * InitializeBlitKernel() を呼ぶまでは標準ライブラリを使う実装を指す
+ */
+extern const BlitKernel *blit_kernel;
+
+/** @brief これ以下のピクセル数の操作は blit_kernel を呼ばずにその場で行う
+ *
+ * 文字の1画やマウスカーソルの1行のような短い操作では，
+ * 関数ポインタ経由の呼び出しと各実装の前処理の方が高くつく
+ */
+const size_t kBlitShortPixels = 16;
+
+/** @brief dst から count 個の 32 ビット値 value を書き込む */
+inline void BlitFill32(void *dst, uint32_t value, size_t count) {
+  if (count > kBlitShortPixels) {
+    blit_kernel->fill32(dst, value, count);
+    return;
+  }
+  auto p = static_cast<uint32_t *>(dst);
+  for (size_t i = 0; i < count; ++i) {
+    p[i] = value;
+  }
+}
+
+/** @brief src から dst へ count 個の 32 ビット値をコピーする。
+ * 領域は重なってはいけない */
+inline void BlitCopy32(void *dst, const void *src, size_t count) {
+  if (count > kBlitShortPixels) {
+    blit_kernel->copy(dst, src, 4 * count);
+    return;
+  }
+  auto d = static_cast<uint32_t *>(dst);
+  auto s = static_cast<const uint32_t *>(src);
+  for (size_t i = 0; i < count; ++i) {
+    d[i] = s[i];
+  }
+}
+
+/** @brief CPUID を調べ，この CPU で使える最も速い実装を blit_kernel に設定する
+ *
+ * AVX2 が使える場合は XCR0 で AVX の状態保存を有効にしてから使う
+ */
+void InitializeBlitKernel();
+
+/** @brief この CPU で使えるすべての実装の速度を代表的なウィンドウの大きさで計測し，
+ * 結果を kDebug でログに出力する */
+void BenchmarkBlitKernels();
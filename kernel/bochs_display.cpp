@@ -0,0 +1,191 @@
+#include "bochs_display.hpp"
+
+#include "asmfunc.h"
+#include "blit.hpp"
+
+// dispi_registers
+namespace {
+/** @brief dispi のレジスタを IO ポートで読み書きするときのポート */
+const uint16_t kDispiIOIndex = 0x01ce;
+const uint16_t kDispiIOData = 0x01cf;
+/** @brief BAR2 の MMIO 領域の中で dispi のレジスタが置かれている位置 */
+const uint64_t kDispiMMIOOffset = 0x500;
+
+const uint16_t kIndexID = 0x0;
+const uint16_t kIndexXRes = 0x1;
+const uint16_t kIndexYRes = 0x2;
+const uint16_t kIndexBPP = 0x3;
+const uint16_t kIndexEnable = 0x4;
+const uint16_t kIndexVirtWidth = 0x6;
+const uint16_t kIndexVirtHeight = 0x7;
+const uint16_t kIndexXOffset = 0x8;
+const uint16_t kIndexYOffset = 0x9;
+const uint16_t kIndexVideoMemory64K = 0xa;
+
+const uint16_t kIDMin = 0xb0c0;
+const uint16_t kIDMax = 0xb0c5;
+/** @brief kIndexVideoMemory64K を読めるようになった版 */
+const uint16_t kIDVideoMemory = 0xb0c5;
+
+const uint16_t kEnabled = 0x01;
+/** @brief 解像度のレジスタから上限を読むためのビット。モードには含めない */
+const uint16_t kGetCaps = 0x02;
+const uint16_t kLFBEnabled = 0x40;
+const uint16_t kNoClearMem = 0x80;
+
+const int kBytesPerPixel = 4;
+
+/** @brief 2つの矩形を両方とも含む最小の矩形を返す。空の矩形は無視する */
+Rectangle<int> BoundingBox(const Rectangle<int> &a, const Rectangle<int> &b) {
+  if (IsEmpty(a)) {
+    return b;
+  }
+  if (IsEmpty(b)) {
+    return a;
+  }
+  const auto pos = ElementMin(a.pos, b.pos);
+  const auto end = ElementMax(a.pos + a.size, b.pos + b.size);
+  return {pos, end - pos};
+}
+} // namespace
+// dispi_registers
+
+BochsDisplay *bochs_display;
+
+// bochs_initialize
+Error BochsDisplay::Initialize(pci::Device &dev, int width, int height) {
+  const auto fb_bar = pci::ReadBar(dev, 0);
+  if (fb_bar.error) {
+    return fb_bar.error;
+  }
+  const auto bar_mask = ~static_cast<uint64_t>(0xf);
+  vram_ = reinterpret_cast<uint8_t *>(fb_bar.value & bar_mask);
+
+  // QEMU の装置は BAR2 の MMIO 領域にもレジスタを持つ。
+  // bochs-display は IO ポートを持たないので，あれば MMIO を使う
+  const auto mmio_bar = pci::ReadBar(dev, 2);
+  const auto mmio_base = mmio_bar.value & bar_mask;
+  mmio_ = nullptr;
+  if (!mmio_bar.error && (mmio_bar.value & 1) == 0 && mmio_base != 0) {
+    mmio_ =
+        reinterpret_cast<volatile uint16_t *>(mmio_base + kDispiMMIOOffset);
+  }
+
+  const auto id = ReadRegister(kIndexID);
+  if (id < kIDMin || id > kIDMax) {
+    return MAKE_ERROR(Error::kUnknownDevice);
+  }
+  const size_t pages_bytes =
+      2 * kBytesPerPixel * static_cast<size_t>(width) * height;
+  if (id >= kIDVideoMemory &&
+      ReadRegister(kIndexVideoMemory64K) * 64 * 1024ul < pages_bytes) {
+    return MAKE_ERROR(Error::kNoEnoughMemory);
+  }
+
+  // 仮想画面の高さは VRAM の大きさから装置が決めるので，モードを設定して
+  // からでないと分からない。足りなければ UEFI が設定したモードに戻し，
+  // 呼び出し側が UEFI の行の長さのまま VRAM へ直接書き込めるようにする
+  const auto original_mode = ReadMode();
+  WriteMode({kEnabled | kLFBEnabled, static_cast<uint16_t>(width),
+             static_cast<uint16_t>(height), 8 * kBytesPerPixel,
+             static_cast<uint16_t>(width), 0, 0});
+  if (ReadRegister(kIndexVirtHeight) < 2 * height) {
+    WriteMode(original_mode);
+    return MAKE_ERROR(Error::kNoEnoughMemory);
+  }
+
+  width_ = width;
+  height_ = height;
+  visible_page_ = 0;
+  // どちらのページもバックバッファとは一致していない
+  const Rectangle<int> whole{{0, 0}, {width, height}};
+  stale_[0] = stale_[1] = whole;
+  return MAKE_ERROR(Error::kSuccess);
+}
+// bochs_initialize
+
+// bochs_present
+unsigned long BochsDisplay::Present(const FrameBuffer &src,
+                                    const Rectangle<int> &area) {
+  const int page = 1 - visible_page_;
+  const Rectangle<int> screen_area{{0, 0}, {width_, height_}};
+  const auto write_area = BoundingBox(area, stale_[page]) & screen_area;
+
+  const auto &config = src.Config();
+  for (int y = write_area.pos.y; y < write_area.pos.y + write_area.size.y;
+       ++y) {
+    const auto src_row = reinterpret_cast<const uint32_t *>(
+        config.frame_buffer +
+        kBytesPerPixel * (config.pixels_per_scan_line * y + write_area.pos.x));
+    auto dst_row =
+        reinterpret_cast<uint32_t *>(PageAt(page, {write_area.pos.x, y}));
+    // dispi の 32 ビットカラーは BGR の並び
+    if (config.pixel_format == kPixelBGRResv8BitPerColor) {
+      BlitCopy32(dst_row, src_row, write_area.size.x);
+      continue;
+    }
+    for (int x = 0; x < write_area.size.x; ++x) {
+      dst_row[x] = ConvertNativePixel(config.pixel_format,
+                                      kPixelBGRResv8BitPerColor, src_row[x]);
+    }
+  }
+
+  // 表示を切り替えると，今まで表示していたページが area の分だけ古くなる
+  stale_[page] = {};
+  stale_[visible_page_] = BoundingBox(stale_[visible_page_], area);
+  WriteRegister(kIndexYOffset, page * height_);
+  visible_page_ = page;
+  ++flips_;
+  return static_cast<unsigned long>(write_area.size.x) * write_area.size.y;
+}
+// bochs_present
+
+size_t BochsDisplay::PagesBytes() const {
+  return 2 * kBytesPerPixel * static_cast<size_t>(width_) * height_;
+}
+
+uint16_t BochsDisplay::ReadRegister(uint16_t index) const {
+  if (mmio_) {
+    return mmio_[index];
+  }
+  IoOut16(kDispiIOIndex, index);
+  return IoIn16(kDispiIOData);
+}
+
+void BochsDisplay::WriteRegister(uint16_t index, uint16_t value) {
+  if (mmio_) {
+    mmio_[index] = value;
+    return;
+  }
+  IoOut16(kDispiIOIndex, index);
+  IoOut16(kDispiIOData, value);
+}
+
+BochsDisplay::Mode BochsDisplay::ReadMode() const {
+  const uint16_t enable = ReadRegister(kIndexEnable) & ~kGetCaps;
+  return {enable,
+          ReadRegister(kIndexXRes),
+          ReadRegister(kIndexYRes),
+          ReadRegister(kIndexBPP),
+          ReadRegister(kIndexVirtWidth),
+          ReadRegister(kIndexXOffset),
+          ReadRegister(kIndexYOffset)};
+}
+
+void BochsDisplay::WriteMode(const Mode &mode) {
+  // 解像度は無効にしている間だけ変更できる。
+  // UEFI が描いた内容を残すため，有効にするときに VRAM を消さない
+  WriteRegister(kIndexEnable, 0);
+  WriteRegister(kIndexXRes, mode.x_res);
+  WriteRegister(kIndexYRes, mode.y_res);
+  WriteRegister(kIndexBPP, mode.bpp);
+  WriteRegister(kIndexEnable, mode.enable | kNoClearMem);
+  WriteRegister(kIndexVirtWidth, mode.virt_width);
+  WriteRegister(kIndexXOffset, mode.x_offset);
+  WriteRegister(kIndexYOffset, mode.y_offset);
+}
+
+uint8_t *BochsDisplay::PageAt(int page, Vector2D<int> pos) const {
+  const size_t y = static_cast<size_t>(page) * height_ + pos.y;
+  return vram_ + kBytesPerPixel * (y * width_ + pos.x);
+}
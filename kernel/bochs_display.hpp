@@ -0,0 +1,70 @@
+/**
+ * @file bochs_display.hpp
+ *
+ * QEMU の -vga std や bochs-display が提供する Bochs dispi インターフェースの
+ * ドライバ。VRAM に画面2枚分のページを確保し，表示するページを
+ * 仮想画面の Y オフセットで切り替える（ページフリップ）。
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "error.hpp"
+#include "frame_buffer.hpp"
+#include "pci.hpp"
+#include "scanout.hpp"
+
+/** @brief Bochs dispi 互換の表示装置 */
+class BochsDisplay : public Scanout {
+public:
+  static const uint16_t kVendorID = 0x1234;
+  static const uint16_t kDeviceID = 0x1111;
+
+  /** @brief dev を width x height の 32 ビットカラーの画面に設定する
+   *
+   * 仮想画面の高さを 2 * height にして，上半分と下半分をページとして使う。
+   * VRAM が足りなければエラーを返す。その場合，表示モードは呼び出す前のまま
+   */
+  Error Initialize(pci::Device &dev, int width, int height);
+
+  /** @brief src の area の範囲を表示していないページに書き込み，
+   * そのページに表示を切り替える
+   *
+   * 書き込むページには，前回そのページを表示してから他方のページにだけ
+   * 書き込んだ範囲も合わせて書き込む
+   */
+  virtual unsigned long Present(const FrameBuffer &src,
+                                const Rectangle<int> &area) override;
+
+  /** @brief VRAM の先頭の物理アドレスを返す */
+  uint8_t *VRAM() const { return vram_; }
+  /** @brief 2ページ分の VRAM の大きさをバイト単位で返す */
+  size_t PagesBytes() const;
+  /** @brief これまでにページを切り替えた回数を返す */
+  unsigned long Flips() const { return flips_; }
+
+private:
+  /** @brief 表示モードを決める dispi のレジスタの値 */
+  struct Mode {
+    uint16_t enable, x_res, y_res, bpp, virt_width, x_offset, y_offset;
+  };
+
+  uint16_t ReadRegister(uint16_t index) const;
+  void WriteRegister(uint16_t index, uint16_t value);
+  Mode ReadMode() const;
+  /** @brief 表示を無効にしてから mode を設定する。VRAM の内容は消さない */
+  void WriteMode(const Mode &mode);
+  uint8_t *PageAt(int page, Vector2D<int> pos) const;
+
+  /** @brief dispi のレジスタ。MMIO で読み書きできなければ nullptr */
+  volatile uint16_t *mmio_{nullptr};
+  uint8_t *vram_{nullptr};
+  int width_{0}, height_{0};
+  int visible_page_{0};
+  /** @brief 各ページで，もう一方のページより古い内容が残っている範囲 */
+  Rectangle<int> stale_[2]{};
+  unsigned long flips_{0};
+};
+
+extern BochsDisplay *bochs_display;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 
 #include "console.hpp"
@@ -8,7 +9,10 @@
 // constructor
 Console::Console(const PixelColor &fg_color, const PixelColor &bg_color)
     : writer_{nullptr}, window_{}, fg_color_{fg_color}, bg_color_{bg_color},
-      buffer_{}, cursor_row_{0}, cursor_column_{0} {}
+      buffer_{}, cursor_row_{0}, cursor_column_{0}, layer_id_{0},
+      dirty_columns_{}, redraw_all_{false} {
+  ClearDirty();
+}
 // constructor
 
 // put_string
@@ -17,19 +21,77 @@ void Console::PutString(const char *s) {
     if (*s == '\n') {
       Newline();
     } else if (cursor_column_ < kColumns - 1) {
-      WriteAscii(*writer_, Vector2D<int>{cursor_column_ * 8, 16 * cursor_row_},
-                 *s, fg_color_);
       buffer_[cursor_row_][cursor_column_] = *s;
+      if (window_) {
+        // ウィンドウへの描画は Flush までまとめて遅らせる
+        auto &dirty = dirty_columns_[cursor_row_];
+        dirty.begin = std::min(dirty.begin, cursor_column_);
+        dirty.end = std::max(dirty.end, cursor_column_ + 1);
+      } else {
+        WriteAscii(*writer_,
+                   Vector2D<int>{cursor_column_ * 8, 16 * cursor_row_}, *s,
+                   fg_color_, bg_color_);
+      }
       cursor_column_++;
     }
     ++s;
   }
-  if (layer_manager) {
-    layer_manager->Draw();
+  if (!window_) {
+    if (layer_manager) {
+      layer_manager->Draw();
+    }
+  } else if (layer_id_ == 0) {
+    // 表示するレイヤーが決まっていなければ従来どおりすぐに描く
+    Flush();
   }
 }
 // put_string
 
+// console_flush
+void Console::Flush() {
+  if (!window_) {
+    return;
+  }
+
+  bool changed = redraw_all_;
+  for (int row = 0; row < kRows; ++row) {
+    const auto &dirty = dirty_columns_[row];
+    for (int column = dirty.begin; column < dirty.end; ++column) {
+      WriteAscii(*writer_, Vector2D<int>{column * 8, 16 * row},
+                 buffer_[row][column], fg_color_, bg_color_);
+      changed = true;
+    }
+  }
+  if (!changed || !layer_manager) {
+    ClearDirty();
+    return;
+  }
+
+  if (layer_id_ == 0) {
+    layer_manager->Draw();
+  } else if (redraw_all_) {
+    layer_manager->Draw(layer_id_);
+  } else {
+    // 書き換えた行の，書き換えた桁の範囲だけを合成し直す
+    for (int row = 0; row < kRows; ++row) {
+      const auto &dirty = dirty_columns_[row];
+      if (dirty.begin < dirty.end) {
+        layer_manager->Draw(layer_id_, {{8 * dirty.begin, 16 * row},
+                                        {8 * (dirty.end - dirty.begin), 16}});
+      }
+    }
+  }
+  ClearDirty();
+}
+
+void Console::ClearDirty() {
+  for (auto &dirty : dirty_columns_) {
+    dirty = {kColumns, 0};
+  }
+  redraw_all_ = false;
+}
+// console_flush
+
 void Console::SetWriter(PixelWriter *writer) {
   if (writer == writer_) {
     return;
@@ -37,6 +99,7 @@ void Console::SetWriter(PixelWriter *writer) {
   writer_ = writer;
   window_.reset();
   Refresh();
+  ClearDirty();
 }
 
 // set_window
@@ -48,9 +111,15 @@ void Console::SetWindow(const std::shared_ptr<Window> &window) {
   window_ = window;
   writer_ = window->Writer();
   Refresh();
+  ClearDirty();
+  redraw_all_ = true;
 }
 // set_window
 
+void Console::SetLayerID(unsigned int layer_id) { layer_id_ = layer_id; }
+
+unsigned int Console::LayerID() const { return layer_id_; }
+
 // newline
 void Console::Newline() {
   cursor_column_ = 0;
@@ -58,34 +127,47 @@ void Console::Newline() {
     cursor_row_++;
     return;
   }
-  if (window_) {
+  if (window_ && window_->Height() == 16 * kRows) {
+    // ウィンドウの先頭行をずらすだけで，ピクセルは動かさない
+    window_->Scroll(16);
+    FillRectangle(*writer_, {0, 16 * (kRows - 1)}, {8 * kColumns, 16},
+                  bg_color_);
+    redraw_all_ = true;
+  } else if (window_) {
     Rectangle<int> move_src{{0, 16}, {8 * kColumns, 16 * (kRows - 1)}};
     window_->Move({0, 0}, move_src);
     FillRectangle(*writer_, {0, 16 * (kRows - 1)}, {8 * kColumns, 16},
                   bg_color_);
-
+    redraw_all_ = true;
   } else {
     // 背景色に塗りつぶし
-    FillRectangle(*writer_, {0, 16 * (kRows - 1)}, {8 * kColumns, 16},
-                  bg_color_);
+    FillRectangle(*writer_, {0, 0}, {8 * kColumns, 16 * kRows}, bg_color_);
 
     // 改行した文字列を書き込む
     for (int row = 0; row < kRows - 1; ++row) {
-      // memcpy(dst, src, size):  srcの戦闘からsizeバイトをdestにこぴーする　
-      memcpy(buffer_[row], buffer_[row + 1], kColumns + 1);
-      WriteString(*writer_, Vector2D<int>{0, 16 * row}, buffer_[row],
-                  fg_color_);
+      WriteString(*writer_, Vector2D<int>{0, 16 * row}, buffer_[row + 1],
+                  fg_color_, bg_color_);
     }
-    // memset(s, c, n): sをnバイト分cで埋める
-    memset(buffer_[kRows - 1], 0, kColumns + 1);
   }
+
+  for (int row = 0; row < kRows - 1; ++row) {
+    // memcpy(dst, src, size):  srcの戦闘からsizeバイトをdestにこぴーする　
+    memcpy(buffer_[row], buffer_[row + 1], kColumns + 1);
+    // まだ描いていない文字も行と一緒に上へずれる
+    dirty_columns_[row] = dirty_columns_[row + 1];
+  }
+  // memset(s, c, n): sをnバイト分cで埋める
+  memset(buffer_[kRows - 1], 0, kColumns + 1);
+  dirty_columns_[kRows - 1] = {kColumns, 0};
 }
 // newline
 
 // console_refresh
 void Console::Refresh() {
+  FillRectangle(*writer_, {0, 0}, {8 * kColumns, 16 * kRows}, bg_color_);
   for (int row = 0; row < kRows; ++row) {
-    WriteString(*writer_, Vector2D<int>{0, 16 * row}, buffer_[row], fg_color_);
+    WriteString(*writer_, Vector2D<int>{0, 16 * row}, buffer_[row], fg_color_,
+                bg_color_);
   }
 }
 // console_refresh
@@ -14,17 +14,38 @@ public:
   static const int kRows = 25, kColumns = 80;
   Console(const PixelColor &fg_color, const PixelColor &bg_color);
 
+  /** @brief 文字列を書き込む
+   *
+   * ウィンドウとレイヤーが設定されている場合，描画は Flush まで遅らせる
+   */
   void PutString(const char *s);
+  /** @brief PutString 以降に変化した文字だけをウィンドウへ描き，
+   * その範囲だけを合成し直す。メインループから 1 フレームに 1 回呼ぶ */
+  void Flush();
   void SetWriter(PixelWriter *writer);
   void SetWindow(const std::shared_ptr<Window> &window);
+  /** @brief 描画先のウィンドウを表示するレイヤーを設定する。
+   * 以降は文字を書くたびにこのレイヤーだけを描き直す */
+  void SetLayerID(unsigned int layer_id);
+  unsigned int LayerID() const;
 
 private:
+  /** @brief 1行の中でまだ描いていない桁の範囲 [begin, end) */
+  struct DirtyColumns {
+    int begin, end;
+  };
+
   void Newline();
   void Refresh();
+  void ClearDirty();
 
   PixelWriter *writer_;
   std::shared_ptr<Window> window_;
   const PixelColor fg_color_, bg_color_;
-  char buffer_[kRows][kColumns];
+  char buffer_[kRows][kColumns + 1];
   int cursor_row_, cursor_column_;
+  unsigned int layer_id_;
+  DirtyColumns dirty_columns_[kRows];
+  /** @brief スクロールなどでウィンドウ全体を合成し直す必要がある */
+  bool redraw_all_;
 };
@@ -28,6 +28,8 @@ public:
     kNoWaiter,
     kNoPCIMSI,
     kUnknownPixelFormat,
+    kInvalidFormat,
+    kTimeout,
     kLastOfCode, // この列挙子は常に最後に配置する
   };
 
@@ -55,6 +57,8 @@ private:
       "kNoWaiter",
       "kUnknownPixelFormat",
       "kNoPCIMSI",
+      "kInvalidFormat",
+      "kTimeout",
   };
 
   static_assert(Error::Code::kLastOfCode == code_names_.size());
@@ -1,18 +1,171 @@
 #include "font.hpp"
 #include "graphics.hpp"
+#include "zenkaku_font.hpp"
 
-extern const uint8_t _binary_hankaku_bin_start;
-extern const uint8_t _binary_hankaku_bin_end;
-extern const uint8_t _binary_hankaku_bin_size;
+extern const uint8_t _binary_hankaku_bin_start[];
+extern const uint8_t _binary_hankaku_bin_end[];
+extern const uint8_t _binary_hankaku_bin_size[];
 
 const uint8_t *GetFont(char c) {
-  auto index = 16 * static_cast<int>(c);
-  if (index >= reinterpret_cast<uintptr_t>(&_binary_hankaku_bin_size)) {
+  auto index = 16 * static_cast<unsigned int>(static_cast<uint8_t>(c));
+  if (index >= reinterpret_cast<uintptr_t>(_binary_hankaku_bin_size)) {
     return nullptr;
   }
-  return &_binary_hankaku_bin_start + index;
+  return _binary_hankaku_bin_start + index;
 }
 
+// glyph_cache
+namespace {
+const int kGlyphWidth = 8;
+const int kGlyphHeight = 16;
+
+/** @brief 1行の中で立っているビットが連続する範囲の一覧
+ *
+ * 8 ビットの中に連続する範囲は高々4つ
+ */
+struct GlyphRowSpans {
+  uint8_t count;
+  uint8_t begin[4], length[4];
+};
+
+/** @brief 文字ごとに前もって求めた，各行で描くべき範囲 */
+struct GlyphSpans {
+  bool ready;
+  GlyphRowSpans rows[kGlyphHeight];
+};
+
+GlyphSpans glyph_spans[256];
+
+const GlyphSpans &GetGlyphSpans(const uint8_t *font, char c) {
+  auto &spans = glyph_spans[static_cast<uint8_t>(c)];
+  if (spans.ready) {
+    return spans;
+  }
+  for (int dy = 0; dy < kGlyphHeight; ++dy) {
+    auto &row = spans.rows[dy];
+    row.count = 0;
+    int dx = 0;
+    while (dx < kGlyphWidth) {
+      if (((font[dy] << dx) & 0x80u) == 0) {
+        ++dx;
+        continue;
+      }
+      const int begin = dx;
+      while (dx < kGlyphWidth && ((font[dy] << dx) & 0x80u)) {
+        ++dx;
+      }
+      row.begin[row.count] = begin;
+      row.length[row.count] = dx - begin;
+      ++row.count;
+    }
+  }
+  spans.ready = true;
+  return spans;
+}
+
+/** @brief 前景色と背景色で塗り分け済みの，ネイティブ形式の文字画像 */
+struct GlyphBlock {
+  bool valid;
+  char c;
+  PixelFormat format;
+  uint32_t fg, bg;
+  uint32_t pixels[kGlyphWidth * kGlyphHeight];
+};
+
+/** @brief (文字, 前景色, 背景色, ピクセル形式) をキーとする
+ * ダイレクトマップ方式のキャッシュ。
+ * 同じ色の組で書く限り，文字ごとに別のエントリに入る */
+const int kGlyphCacheSize = 256;
+GlyphBlock glyph_cache[kGlyphCacheSize];
+
+const GlyphBlock &GetGlyphBlock(const uint8_t *font, char c, PixelFormat format,
+                                uint32_t fg, uint32_t bg) {
+  const auto hash = static_cast<uint8_t>(c) ^ ((fg ^ (bg >> 3)) * 0x9e3779b1u);
+  auto &block = glyph_cache[hash % kGlyphCacheSize];
+  if (block.valid && block.c == c && block.format == format &&
+      block.fg == fg && block.bg == bg) {
+    return block;
+  }
+
+  block.valid = true;
+  block.c = c;
+  block.format = format;
+  block.fg = fg;
+  block.bg = bg;
+  for (int dy = 0; dy < kGlyphHeight; ++dy) {
+    for (int dx = 0; dx < kGlyphWidth; ++dx) {
+      block.pixels[kGlyphWidth * dy + dx] =
+          ((font[dy] << dx) & 0x80u) ? fg : bg;
+    }
+  }
+  return block;
+}
+/** @brief 全角フォントの文字を描く。bg_color が無ければ背景は透過する */
+void WriteWideGlyph(PixelWriter &writer, Vector2D<int> pos,
+                    const ZenkakuGlyph &glyph, const PixelColor &color,
+                    const PixelColor *bg_color) {
+  if (bg_color == nullptr) {
+    for (int dy = 0; dy < kGlyphHeight; ++dy) {
+      const unsigned row = (glyph.rows[2 * dy] << 8) | glyph.rows[2 * dy + 1];
+      int dx = 0;
+      while (dx < glyph.width) {
+        if (((row << dx) & 0x8000u) == 0) {
+          ++dx;
+          continue;
+        }
+        const int begin = dx;
+        while (dx < glyph.width && ((row << dx) & 0x8000u)) {
+          ++dx;
+        }
+        writer.FillSpan(pos + Vector2D<int>{begin, dy}, dx - begin, color);
+      }
+    }
+    return;
+  }
+
+  const auto format = writer.Format();
+  const auto fg = ToNativePixel(format, color);
+  const auto bg = ToNativePixel(format, *bg_color);
+  uint32_t pixels[16 * kGlyphHeight];
+  for (int dy = 0; dy < kGlyphHeight; ++dy) {
+    const unsigned row = (glyph.rows[2 * dy] << 8) | glyph.rows[2 * dy + 1];
+    for (int dx = 0; dx < glyph.width; ++dx) {
+      pixels[glyph.width * dy + dx] = ((row << dx) & 0x8000u) ? fg : bg;
+    }
+  }
+  writer.BlitRect(pos, pixels, glyph.width, {glyph.width, kGlyphHeight},
+                  format);
+}
+
+/** @brief c を描き，描いた幅を返す */
+int WriteUnicodeImpl(PixelWriter &writer, Vector2D<int> pos, char32_t c,
+                     const PixelColor &color, const PixelColor *bg_color) {
+  auto write_ascii = [&](char ascii) {
+    if (bg_color) {
+      WriteAscii(writer, pos, ascii, color, *bg_color);
+    } else {
+      WriteAscii(writer, pos, ascii, color);
+    }
+    return kGlyphWidth;
+  };
+
+  if (c < 0x80) {
+    return write_ascii(static_cast<char>(c));
+  }
+  if (c >= 0xff61 && c <= 0xff9f) {
+    // 半角カナは hankaku の JIS X 0201 の位置にある
+    return write_ascii(static_cast<char>(c - 0xff61 + 0xa1));
+  }
+  const auto glyph = GetZenkakuGlyph(c);
+  if (glyph.width > 0) {
+    WriteWideGlyph(writer, pos, glyph, color, bg_color);
+    return glyph.width;
+  }
+  return write_ascii('?');
+}
+} // namespace
+// glyph_cache
+
 // write_ascii
 void WriteAscii(PixelWriter &writer, Vector2D<int> pos, char c,
                 const PixelColor &color) {
@@ -20,21 +173,114 @@ void WriteAscii(PixelWriter &writer, Vector2D<int> pos, char c,
   if (font == nullptr) {
     return;
   }
-  for (int dy = 0; dy < 16; ++dy) {
-    for (int dx = 0; dx < 8; ++dx) {
-      if ((font[dy] << dx) & 0x80u) {
-        writer.Write(pos + Vector2D<int>{dx, dy}, color);
-      }
+  // 各行で連続して立っているビットをまとめて描く
+  const auto &spans = GetGlyphSpans(font, c);
+  for (int dy = 0; dy < kGlyphHeight; ++dy) {
+    const auto &row = spans.rows[dy];
+    for (int i = 0; i < row.count; ++i) {
+      writer.FillSpan(pos + Vector2D<int>{row.begin[i], dy}, row.length[i],
+                      color);
     }
   }
 }
+
+void WriteAscii(PixelWriter &writer, Vector2D<int> pos, char c,
+                const PixelColor &color, const PixelColor &bg_color) {
+  const uint8_t *font = GetFont(c);
+  if (font == nullptr) {
+    return;
+  }
+  const auto format = writer.Format();
+  const auto &block =
+      GetGlyphBlock(font, c, format, ToNativePixel(format, color),
+                    ToNativePixel(format, bg_color));
+  writer.BlitRect(pos, block.pixels, kGlyphWidth, {kGlyphWidth, kGlyphHeight},
+                  format);
+}
 // write_ascii
 
+// write_unicode
+int DecodeUTF8(const char *s, char32_t &c) {
+  // 各バイト数で表すべき最小の値。これより小さければ冗長な表現として扱う
+  static const char32_t kMinimum[] = {0, 0, 0x80, 0x800, 0x10000};
+  const auto u = reinterpret_cast<const uint8_t *>(s);
+  int length = 1;
+  if (u[0] < 0x80) {
+    c = u[0];
+    return 1;
+  } else if ((u[0] & 0xe0) == 0xc0) {
+    c = u[0] & 0x1f;
+    length = 2;
+  } else if ((u[0] & 0xf0) == 0xe0) {
+    c = u[0] & 0x0f;
+    length = 3;
+  } else if ((u[0] & 0xf8) == 0xf0) {
+    c = u[0] & 0x07;
+    length = 4;
+  } else {
+    c = u[0];
+    return 1;
+  }
+  for (int i = 1; i < length; ++i) {
+    if ((u[i] & 0xc0) != 0x80) {
+      c = u[0];
+      return 1;
+    }
+    c = (c << 6) | (u[i] & 0x3f);
+  }
+  // サロゲートと U+10FFFF より大きい値も文字ではないので同じく扱う
+  if (c < kMinimum[length] || (0xd800 <= c && c <= 0xdfff) || c > 0x10ffff) {
+    c = u[0];
+    return 1;
+  }
+  return length;
+}
+
+int WriteUnicode(PixelWriter &writer, Vector2D<int> pos, char32_t c,
+                 const PixelColor &color) {
+  return WriteUnicodeImpl(writer, pos, c, color, nullptr);
+}
+
+int WriteUnicode(PixelWriter &writer, Vector2D<int> pos, char32_t c,
+                 const PixelColor &color, const PixelColor &bg_color) {
+  return WriteUnicodeImpl(writer, pos, c, color, &bg_color);
+}
+// write_unicode
+
 // write_string
+namespace {
+/** @brief 1バイトで解釈できた文字が，UTF-8 として正しくないバイトなら true */
+bool IsInvalidByte(int length, char32_t c) { return length == 1 && c >= 0x80; }
+} // namespace
+
 void WriteString(PixelWriter &writer, Vector2D<int> pos, const char *s,
                  const PixelColor &color) {
-  for (int i = 0; s[i] != '\0'; ++i) {
-    WriteAscii(writer, pos + Vector2D<int>{8 * i, 0}, s[i], color);
+  while (*s) {
+    char32_t c;
+    const int length = DecodeUTF8(s, c);
+    s += length;
+    // UTF-8 として解釈できなかったバイトは従来どおり hankaku で描く
+    if (IsInvalidByte(length, c)) {
+      WriteAscii(writer, pos, static_cast<char>(c), color);
+      pos.x += kGlyphWidth;
+      continue;
+    }
+    pos.x += WriteUnicode(writer, pos, c, color);
+  }
+}
+
+void WriteString(PixelWriter &writer, Vector2D<int> pos, const char *s,
+                 const PixelColor &color, const PixelColor &bg_color) {
+  while (*s) {
+    char32_t c;
+    const int length = DecodeUTF8(s, c);
+    s += length;
+    if (IsInvalidByte(length, c)) {
+      WriteAscii(writer, pos, static_cast<char>(c), color, bg_color);
+      pos.x += kGlyphWidth;
+      continue;
+    }
+    pos.x += WriteUnicode(writer, pos, c, color, bg_color);
   }
 }
 // write_string
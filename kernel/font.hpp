@@ -4,8 +4,39 @@
 
 #include "graphics.hpp"
 
+/** @brief 文字を color で描く。文字の背景は描かない（透過する） */
 void WriteAscii(PixelWriter &writer, Vector2D<int> pos, char c,
                 const PixelColor &color);
+/** @brief 文字を color で，背景を bg_color で描く
+ *
+ * 色の組ごとに変換済みの文字画像をキャッシュし，8x16 の矩形として転送する
+ */
+void WriteAscii(PixelWriter &writer, Vector2D<int> pos, char c,
+                const PixelColor &color, const PixelColor &bg_color);
+
+/** @brief UTF-8 の文字列 s の先頭の1文字を c に取り出し，使ったバイト数を返す
+ *
+ * UTF-8 として正しくないバイト（冗長な表現，サロゲート，U+10FFFF を超える値を
+ * 含む）は，そのバイトの値を c にして 1 を返す。1 を返して c が 0x80 以上なら
+ * 正しくないバイトである
+ */
+int DecodeUTF8(const char *s, char32_t &c);
 
+/** @brief Unicode の文字 c を描き，描いた幅をピクセル単位で返す
+ *
+ * ASCII と半角カナは hankaku で，それ以外は全角フォントで描く。
+ * 全角フォントに無い文字は '?' を描く
+ */
+int WriteUnicode(PixelWriter &writer, Vector2D<int> pos, char32_t c,
+                 const PixelColor &color);
+int WriteUnicode(PixelWriter &writer, Vector2D<int> pos, char32_t c,
+                 const PixelColor &color, const PixelColor &bg_color);
+
+/** @brief UTF-8 の文字列を描く
+ *
+ * UTF-8 として正しくないバイトは，そのバイトの文字を hankaku で描く
+ */
 void WriteString(PixelWriter &writer, Vector2D<int> pos, const char *s,
                  const PixelColor &color);
+void WriteString(PixelWriter &writer, Vector2D<int> pos, const char *s,
+                 const PixelColor &color, const PixelColor &bg_color);
@@ -1,8 +1,11 @@
 #include "frame_buffer.hpp"
+#include "blit.hpp"
 #include "error.hpp"
 #include "frame_buffer_config.hpp"
 #include "graphics.hpp"
+#include "memory_manager.hpp"
 #include <cstdint>
+#include <cstring>
 
 // uitls
 namespace {
@@ -35,6 +38,12 @@ Vector2D<int> FrameBufferSize(const FrameBufferConfig &config) {
 // utils
 
 // Initialize
+FrameBuffer::~FrameBuffer() {
+  if (large_buffer_) {
+    FreeLargeBuffer(large_buffer_, large_buffer_bytes_);
+  }
+}
+
 Error FrameBuffer::Initialize(const FrameBufferConfig &config) {
   config_ = config;
 
@@ -48,12 +57,35 @@ Error FrameBuffer::Initialize(const FrameBufferConfig &config) {
     return MAKE_ERROR(Error::kUnknownPixelFormat);
   }
 
+  if (large_buffer_) {
+    FreeLargeBuffer(large_buffer_, large_buffer_bytes_);
+    large_buffer_ = nullptr;
+    large_buffer_bytes_ = 0;
+  }
+
   if (config_.frame_buffer) {
     buffer_.resize(0);
   } else {
-    buffer_.resize(bytes_per_pixel * config_.horizontal_resolution *
-                   config_.vertical_resolution);
-    config_.frame_buffer = buffer_.data();
+    const size_t bytes = bytes_per_pixel * config_.horizontal_resolution *
+                         config_.vertical_resolution;
+    if (bytes >= kLargeBufferThreshold) {
+      auto large = AllocateLargeBuffer(bytes);
+      if (!large.error) {
+        large_buffer_ = large.value;
+        large_buffer_bytes_ = bytes;
+      }
+    }
+
+    if (large_buffer_) {
+      // std::vector で確保したときと同じく 0 で埋めた状態から始める
+      memset(large_buffer_, 0, bytes);
+      buffer_.clear();
+      buffer_.shrink_to_fit();
+      config_.frame_buffer = large_buffer_;
+    } else {
+      buffer_.resize(bytes);
+      config_.frame_buffer = buffer_.data();
+    }
     config_.pixels_per_scan_line = config_.horizontal_resolution;
   }
 
@@ -75,6 +107,12 @@ Error FrameBuffer::Initialize(const FrameBufferConfig &config) {
 
 // copy
 Error FrameBuffer::Copy(Vector2D<int> dst_pos, const FrameBuffer &src) {
+  const Rectangle<int> src_area{{0, 0}, FrameBufferSize(src.config_)};
+  return Copy(dst_pos, src, src_area);
+}
+
+Error FrameBuffer::Copy(Vector2D<int> dst_pos, const FrameBuffer &src,
+                        const Rectangle<int> &src_area) {
   if (config_.pixel_format != src.config_.pixel_format) {
     return MAKE_ERROR(Error::kUnknownPixelFormat);
   }
@@ -85,17 +123,22 @@ Error FrameBuffer::Copy(Vector2D<int> dst_pos, const FrameBuffer &src) {
     return MAKE_ERROR(Error::kUnknownPixelFormat);
   }
 
-  const auto dst_size = FrameBufferSize(config_);
-  const auto src_size = FrameBufferSize(src.config_);
-
-  const Vector2D<int> dst_start = ElementMax(dst_pos, {0, 0});
-  const Vector2D<int> dst_end = ElementMin(dst_pos + src_size, dst_size);
+  // コピー元，コピー先，コピー範囲の共通部分をコピー先の座標で求める
+  const Rectangle<int> src_area_shifted{dst_pos, src_area.size};
+  const Rectangle<int> src_outline{dst_pos - src_area.pos,
+                                   FrameBufferSize(src.config_)};
+  const Rectangle<int> dst_outline{{0, 0}, FrameBufferSize(config_)};
+  const auto copy_area = dst_outline & src_outline & src_area_shifted;
+  if (IsEmpty(copy_area)) {
+    return MAKE_ERROR(Error::kSuccess);
+  }
+  const auto src_start_pos = copy_area.pos - (dst_pos - src_area.pos);
 
-  uint8_t *dst_buf = FrameAddrAt(dst_start, config_);
-  const uint8_t *src_buf = FrameAddrAt({0, 0}, src.config_);
+  uint8_t *dst_buf = FrameAddrAt(copy_area.pos, config_);
+  const uint8_t *src_buf = FrameAddrAt(src_start_pos, src.config_);
 
-  for (int y = dst_start.y; y < dst_end.y; ++y) {
-    memcpy(dst_buf, src_buf, bytes_per_pixel * (dst_end.x - dst_start.x));
+  for (int y = 0; y < copy_area.size.y; ++y) {
+    BlitCopy32(dst_buf, src_buf, copy_area.size.x);
     dst_buf += BytesPerScanLine(config_);
     src_buf += BytesPerScanLine(src.config_);
   }
@@ -111,17 +154,18 @@ void FrameBuffer::Move(Vector2D<int> dst_pos, const Rectangle<int> &src) {
     uint8_t *dst_buf = FrameAddrAt(dst_pos, config_);
     const uint8_t *src_buf = FrameAddrAt(src.pos, config_);
     for (int y = 0; y < src.size.y; ++y) {
-      memcpy(dst_buf, src_buf, bytes_per_pixel * src.size.x);
+      blit_kernel->move(dst_buf, src_buf, bytes_per_pixel * src.size.x);
       dst_buf += bytes_per_scan_line;
       src_buf += bytes_per_scan_line;
     }
   } else {
-    uint8_t *dst_buf = FrameAddrAt(dst_pos, config_);
+    uint8_t *dst_buf =
+        FrameAddrAt(dst_pos + Vector2D<int>{0, src.size.y - 1}, config_);
     const uint8_t *src_buf =
         FrameAddrAt(src.pos + Vector2D<int>{0, src.size.y - 1}, config_);
 
     for (int y = 0; y < src.size.y; ++y) {
-      memcpy(dst_buf, src_buf, bytes_per_pixel * src.size.x);
+      blit_kernel->move(dst_buf, src_buf, bytes_per_pixel * src.size.x);
       dst_buf -= bytes_per_scan_line;
       src_buf -= bytes_per_scan_line;
     }
@@ -130,6 +174,93 @@ void FrameBuffer::Move(Vector2D<int> dst_pos, const Rectangle<int> &src) {
 }
 // move
 
+// back_buffer
+Error FrameBuffer::InitializeBackBuffer() {
+  FrameBufferConfig config{config_};
+  config.frame_buffer = nullptr;
+
+  back_buffer_ = std::make_unique<FrameBuffer>();
+  if (auto err = back_buffer_->Initialize(config)) {
+    back_buffer_.reset();
+    return err;
+  }
+  front_shadow_ = std::make_unique<FrameBuffer>();
+  if (auto err = front_shadow_->Initialize(config)) {
+    back_buffer_.reset();
+    front_shadow_.reset();
+    return err;
+  }
+
+  // 起動時点で画面に出ている内容（コンソール出力など）を写しておく
+  const Rectangle<int> whole{{0, 0}, FrameBufferSize(config_)};
+  front_shadow_->Copy({0, 0}, *this, whole);
+  back_buffer_->Copy({0, 0}, *this, whole);
+  return MAKE_ERROR(Error::kSuccess);
+}
+
+FrameBuffer &FrameBuffer::BackBuffer() {
+  return back_buffer_ ? *back_buffer_ : *this;
+}
+// back_buffer
+
+// present
+void FrameBuffer::Present(const Rectangle<int> &area) {
+  if (!back_buffer_) {
+    return;
+  }
+
+  const Rectangle<int> whole{{0, 0}, FrameBufferSize(config_)};
+  auto present_area = area & whole;
+  if (IsEmpty(present_area)) {
+    return;
+  }
+  if (scanout_) {
+    presented_pixels_ += scanout_->Present(*back_buffer_, present_area);
+    if (!scanout_->Failed()) {
+      return;
+    }
+    // 表示装置が使えなくなったので VRAM へ直接書き込む方法に戻る。
+    // VRAM は前面の写しを作ったときのままなので，画面全体を転送し直す
+    scanout_ = nullptr;
+    present_area = whole;
+  }
+
+  const auto bytes_per_pixel = BytesPerPixel(config_.pixel_format);
+  for (int y = present_area.pos.y;
+       y < present_area.pos.y + present_area.size.y; ++y) {
+    const Vector2D<int> row_pos{present_area.pos.x, y};
+    const auto back = reinterpret_cast<const uint32_t *>(
+        FrameAddrAt(row_pos, back_buffer_->config_));
+    const auto shadow = reinterpret_cast<uint32_t *>(
+        FrameAddrAt(row_pos, front_shadow_->config_));
+    if (memcmp(back, shadow, bytes_per_pixel * present_area.size.x) == 0) {
+      continue;
+    }
+
+    // 変化したピクセルの並びごとに VRAM へ書き込む
+    uint8_t *vram = FrameAddrAt(row_pos, config_);
+    int x = 0;
+    while (x < present_area.size.x) {
+      if (back[x] == shadow[x]) {
+        ++x;
+        continue;
+      }
+      const int begin = x;
+      while (x < present_area.size.x && back[x] != shadow[x]) {
+        ++x;
+      }
+      BlitCopy32(vram + bytes_per_pixel * begin, back + begin, x - begin);
+      BlitCopy32(shadow + begin, back + begin, x - begin);
+      presented_pixels_ += x - begin;
+    }
+  }
+}
+
+unsigned long FrameBuffer::PresentedPixels() const { return presented_pixels_; }
+
+void FrameBuffer::SetScanout(Scanout *scanout) { scanout_ = scanout; }
+// present
+
 // bits_per_pixel
 int BitsPerPixel(PixelFormat format) {
   switch (format) {
@@ -7,19 +7,68 @@
 #include "error.hpp"
 #include "frame_buffer_config.hpp"
 #include "graphics.hpp"
+#include "scanout.hpp"
 
 class FrameBuffer {
 public:
+  ~FrameBuffer();
+  /** @brief config に従ってフレームバッファを初期化する
+   *
+   * config.frame_buffer が nullptr なら RAM 上にバッファを確保する。
+   * kLargeBufferThreshold バイト以上のバッファは AllocateLargeBuffer で
+   * 確保し，失敗したときはヒープから確保する
+   */
   Error Initialize(const FrameBufferConfig &config);
   Error Copy(Vector2D<int> dst_pos, const FrameBuffer &src);
+  /** @brief src の src_area の範囲を，src_area.pos が dst_pos に重なるように
+   * コピーする。はみ出した部分は描画しない */
+  Error Copy(Vector2D<int> dst_pos, const FrameBuffer &src,
+             const Rectangle<int> &src_area);
   void Move(Vector2D<int> dst_pos, const Rectangle<int> &src);
 
+  /** @brief RAM 上にバックバッファを用意する
+   *
+   * VRAM を指すフレームバッファに対して呼び出す。以降の合成は BackBuffer()
+   * に対して行い，Present() で変化した部分だけを VRAM へ転送する
+   * */
+  Error InitializeBackBuffer();
+  /** @brief 合成先のフレームバッファを返す。バックバッファが無ければ自身を返す
+   */
+  FrameBuffer &BackBuffer();
+  /** @brief バックバッファの area の範囲のうち，前回の転送から変化した
+   * ピクセルの並びだけを走査線ごとにこのフレームバッファへ転送する */
+  void Present(const Rectangle<int> &area);
+  /** @brief Present でこのフレームバッファへ書き込んだピクセル数の累計を返す
+   */
+  unsigned long PresentedPixels() const;
+  /** @brief Present の転送先を scanout に切り替える
+   *
+   * 以降はこのフレームバッファ自身の VRAM には書き込まない。
+   * scanout が Failed() を返すようになったら VRAM への書き込みに戻す
+   */
+  void SetScanout(Scanout *scanout);
+
   FrameBufferWriter &Writer() { return *writer_; }
+  const FrameBufferConfig &Config() const { return config_; }
 
 private:
   FrameBufferConfig config_{};
   std::vector<uint8_t> buffer_{};
+  /** @brief AllocateLargeBuffer で確保したバッファ。無ければ nullptr */
+  uint8_t *large_buffer_{nullptr};
+  size_t large_buffer_bytes_{0};
   std::unique_ptr<FrameBufferWriter> writer_{};
+  /** @brief 合成先となる RAM 上のバッファ */
+  std::unique_ptr<FrameBuffer> back_buffer_{};
+  /** @brief このフレームバッファに現在表示されている内容の RAM 上の写し
+   * 変化した部分を VRAM を読まずに求めるために使う */
+  std::unique_ptr<FrameBuffer> front_shadow_{};
+  unsigned long presented_pixels_{0};
+  Scanout *scanout_{nullptr};
 };
 
+/** @brief この大きさ（バイト単位）以上のバッファを AllocateLargeBuffer で
+ * 確保する。画面全体のバックバッファや大きなウィンドウが該当する */
+const size_t kLargeBufferThreshold = 2 * 1024 * 1024;
+
 int BitsPerPixel(PixelFormat format);
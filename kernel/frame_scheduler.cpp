@@ -0,0 +1,72 @@
+#include "frame_scheduler.hpp"
+
+#include "asmfunc.h"
+#include "logger.hpp"
+#include "timer.hpp"
+
+FrameScheduler::FrameScheduler(LayerManager &layer_manager)
+    : layer_manager_{layer_manager} {}
+
+void FrameScheduler::Start(unsigned int frame_rate) {
+  if (frame_rate != 0) {
+    frame_rate_ = frame_rate;
+  }
+  layer_manager_.SetDeferred(true);
+  StartLAPICTimerInterrupt(frame_rate_);
+}
+
+unsigned int FrameScheduler::FrameRate() const { return frame_rate_; }
+
+// frame_scheduler_on_timer
+bool FrameScheduler::OnTimer() {
+  ++stats_.ticks;
+
+  const auto start = ReadTSC();
+  const bool composed = layer_manager_.ComposeFrame();
+  if (composed) {
+    const auto elapsed = TSCToNanoseconds(ReadTSC() - start);
+    ++stats_.frames;
+    stats_.last_compose_ns = elapsed;
+    stats_.total_compose_ns += elapsed;
+    if (stats_.max_compose_ns < elapsed) {
+      stats_.max_compose_ns = elapsed;
+    }
+    NotePresented();
+  } else {
+    ++stats_.idle_ticks;
+  }
+
+  // 1秒ごとに統計を出す。フレームごとにログを出すと，その表示のための
+  // 再描画でまた合成が起きるので，1フレームごとの時間は bench で測る
+  if (stats_.ticks % frame_rate_ == 0 && stats_.frames > 0) {
+    Log(kDebug, "frames = %lu, idle = %lu, compose avg = %lu, max = %lu ns\n",
+        stats_.frames, stats_.idle_ticks,
+        stats_.total_compose_ns / stats_.frames, stats_.max_compose_ns);
+  }
+  return composed;
+}
+// frame_scheduler_on_timer
+
+// frame_scheduler_latency
+void FrameScheduler::NoteInput(uint64_t input_tsc) {
+  if (pending_input_tsc_ == 0) {
+    pending_input_tsc_ = input_tsc;
+  }
+}
+
+void FrameScheduler::NotePresented() {
+  if (pending_input_tsc_ == 0) {
+    return;
+  }
+  const auto latency = TSCToNanoseconds(ReadTSC() - pending_input_tsc_);
+  pending_input_tsc_ = 0;
+  stats_.last_input_latency_ns = latency;
+  if (stats_.max_input_latency_ns < latency) {
+    stats_.max_input_latency_ns = latency;
+  }
+}
+// frame_scheduler_latency
+
+const FrameStats &FrameScheduler::Stats() const { return stats_; }
+
+FrameScheduler *frame_scheduler;
@@ -0,0 +1,72 @@
+/**
+ * @file frame_scheduler.hpp
+ *
+ * LayerManager に記録された再描画範囲を，LAPIC タイマーの周期割り込みに
+ * 合わせて一定の間隔でまとめて合成する。
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "layer.hpp"
+
+/** @brief フレームの合成にかかった時間などの統計 */
+struct FrameStats {
+  /** @brief タイマーの周期の数 */
+  unsigned long ticks;
+  /** @brief 実際に合成したフレームの数 */
+  unsigned long frames;
+  /** @brief 再描画範囲が無く合成しなかった周期の数 */
+  unsigned long idle_ticks;
+  /** @brief 合成にかかった時間（ナノ秒） */
+  uint64_t last_compose_ns, max_compose_ns, total_compose_ns;
+  /** @brief 入力が届いてから画面に反映されるまでの時間（ナノ秒） */
+  uint64_t last_input_latency_ns, max_input_latency_ns;
+};
+
+class FrameScheduler {
+public:
+  static const unsigned int kDefaultFrameRate = 60;
+
+  FrameScheduler(LayerManager &layer_manager);
+
+  /** @brief LayerManager を描画を後回しにする設定にし，
+   * 毎秒 frame_rate 回のタイマー割り込みを開始する。
+   * frame_rate が 0 なら現在の頻度（初期値は kDefaultFrameRate）で動かす */
+  void Start(unsigned int frame_rate = kDefaultFrameRate);
+  unsigned int FrameRate() const;
+
+  /** @brief タイマー割り込みごとにメインループから呼び出す
+   *
+   * 前回から記録された再描画範囲があれば合成して画面に転送する
+   *
+   * @return 合成した場合は true
+   */
+  bool OnTimer();
+
+  /** @brief 画面を変化させる入力が TSC の値 input_tsc の時刻に届いたことを
+   * 記録する
+   *
+   * 反映を待っている入力が既にあれば，古い方の時刻を残す
+   */
+  void NoteInput(uint64_t input_tsc);
+  /** @brief 画面に反映したことを記録し，待っていた入力があれば
+   * 入力から反映までの時間を統計に加える
+   *
+   * 合成したフレームについては OnTimer が呼び出す。
+   * カーソルのように合成を待たずに反映したときは呼び出し側で呼ぶ
+   */
+  void NotePresented();
+
+  const FrameStats &Stats() const;
+
+private:
+  LayerManager &layer_manager_;
+  unsigned int frame_rate_{kDefaultFrameRate};
+  FrameStats stats_{};
+  /** @brief 反映を待っている入力の TSC の値。無ければ 0 */
+  uint64_t pending_input_tsc_{0};
+};
+
+extern FrameScheduler *frame_scheduler;
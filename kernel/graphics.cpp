@@ -1,11 +1,96 @@
 #include "graphics.hpp"
 
+#include "blit.hpp"
+
+void FrameBufferWriter::FillRect(const Rectangle<int> &rect,
+                                 const PixelColor &c) {
+  const auto area = rect & Rectangle<int>{{0, 0}, {Width(), Height()}};
+  if (IsEmpty(area)) {
+    return;
+  }
+  const auto value = ToNativePixel(config_.pixel_format, c);
+  for (int y = area.pos.y; y < area.pos.y + area.size.y; ++y) {
+    BlitFill32(PixelAt({area.pos.x, y}), value, area.size.x);
+  }
+}
+
+void FrameBufferWriter::FillSpan(Vector2D<int> pos, int length,
+                                 const PixelColor &c) {
+  if (pos.y < 0 || pos.y >= Height()) {
+    return;
+  }
+  const int begin = std::max(pos.x, 0);
+  const int end = std::min(pos.x + length, Width());
+  if (begin >= end) {
+    return;
+  }
+  BlitFill32(PixelAt({begin, pos.y}), ToNativePixel(config_.pixel_format, c),
+             end - begin);
+}
+
+void FrameBufferWriter::WriteSpan(Vector2D<int> pos, const PixelColor *colors,
+                                  int length) {
+  if (pos.y < 0 || pos.y >= Height()) {
+    return;
+  }
+  const int begin = std::max(pos.x, 0);
+  const int end = std::min(pos.x + length, Width());
+  auto p = reinterpret_cast<uint32_t *>(PixelAt({begin, pos.y}));
+  for (int x = begin; x < end; ++x) {
+    *p++ = ToNativePixel(config_.pixel_format, colors[x - pos.x]);
+  }
+}
+
+void FrameBufferWriter::BlitRect(Vector2D<int> pos, const uint32_t *src,
+                                 int src_stride, Vector2D<int> size,
+                                 PixelFormat format) {
+  const auto area =
+      Rectangle<int>{pos, size} & Rectangle<int>{{0, 0}, {Width(), Height()}};
+  if (IsEmpty(area)) {
+    return;
+  }
+  const auto src_start = area.pos - pos;
+  for (int dy = 0; dy < area.size.y; ++dy) {
+    const uint32_t *s = src + src_stride * (src_start.y + dy) + src_start.x;
+    auto d =
+        reinterpret_cast<uint32_t *>(PixelAt(area.pos + Vector2D<int>{0, dy}));
+    if (format == config_.pixel_format) {
+      BlitCopy32(d, s, area.size.x);
+      continue;
+    }
+    for (int dx = 0; dx < area.size.x; ++dx) {
+      const auto c = FromNativePixel(format, s[dx]);
+      d[dx] = ToNativePixel(config_.pixel_format, c);
+    }
+  }
+}
+
+void FrameBufferWriter::BlendSpan(Vector2D<int> pos, const uint32_t *src,
+                                  int length, PixelFormat format) {
+  if (pos.y < 0 || pos.y >= Height()) {
+    return;
+  }
+  const int begin = std::max(pos.x, 0);
+  const int end = std::min(pos.x + length, Width());
+  auto p = reinterpret_cast<uint32_t *>(PixelAt({begin, pos.y}));
+  if (format == config_.pixel_format &&
+      end - begin > static_cast<int>(kBlitShortPixels)) {
+    blit_kernel->blend_premultiplied32(p, src + (begin - pos.x), end - begin);
+    return;
+  }
+  for (int x = begin; x < end; ++x, ++p) {
+    const auto value =
+        ConvertNativePixel(format, config_.pixel_format, src[x - pos.x]);
+    *p = BlendPremultiplied(*p, value);
+  }
+}
+
 void RGBResv8BitPerColorPixelWriter::Write(Vector2D<int> pos,
                                            const PixelColor &c) {
   auto p = PixelAt(pos);
   p[0] = c.r;
-  p[1] = c.b;
-  p[2] = c.g;
+  p[1] = c.g;
+  p[2] = c.b;
 }
 
 void BGRResv8BitPerColorPixelWriter::Write(Vector2D<int> pos,
@@ -19,24 +104,16 @@ void BGRResv8BitPerColorPixelWriter::Write(Vector2D<int> pos,
 void DrawRectangle(PixelWriter &writer, const Vector2D<int> &pos,
                    const Vector2D<int> &size, const PixelColor &c) {
   // 上下
-  for (int dx = 0; dx < size.x; ++dx) {
-    writer.Write(pos + Vector2D<int>{dx, 0}, c);
-    writer.Write(pos + Vector2D<int>{dx, size.y - 1}, c);
-  }
+  writer.FillSpan(pos, size.x, c);
+  writer.FillSpan(pos + Vector2D<int>{0, size.y - 1}, size.x, c);
   // 左右
-  for (int dy = 0; dy < size.y; ++dy) {
-    writer.Write(pos + Vector2D<int>{0, dy}, c);
-    writer.Write(pos + Vector2D<int>{size.x - 1, dy}, c);
-  }
+  writer.FillRect({pos, {1, size.y}}, c);
+  writer.FillRect({pos + Vector2D<int>{size.x - 1, 0}, {1, size.y}}, c);
 }
 
 void FillRectangle(PixelWriter &writer, const Vector2D<int> &pos,
                    const Vector2D<int> &size, const PixelColor &c) {
-  for (int dy = 0; dy < size.y; ++dy) {
-    for (int dx = 0; dx < size.x; ++dx) {
-      writer.Write(pos + Vector2D<int>{dx, dy}, c);
-    }
-  }
+  writer.FillRect({pos, size}, c);
 }
 
 void DrawDesktop(PixelWriter &writer) {
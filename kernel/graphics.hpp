@@ -39,8 +39,80 @@ auto operator+(const Vector2D<T> &lhs, const Vector2D<U> &rhs)
 
 */
 }
+
+template <typename T, typename U>
+auto operator-(const Vector2D<T> &lhs, const Vector2D<U> &rhs)
+    -> Vector2D<decltype(lhs.x - rhs.x)> {
+  return {lhs.x - rhs.x, lhs.y - rhs.y};
+}
+
+template <typename T>
+bool operator==(const Vector2D<T> &lhs, const Vector2D<T> &rhs) {
+  return lhs.x == rhs.x && lhs.y == rhs.y;
+}
+
+template <typename T>
+bool operator!=(const Vector2D<T> &lhs, const Vector2D<T> &rhs) {
+  return !(lhs == rhs);
+}
 // vector2d
 
+/** @brief 色をフレームバッファ上の1ピクセル（32ビット）の表現に変換する */
+inline uint32_t ToNativePixel(PixelFormat format, const PixelColor &c) {
+  switch (format) {
+  case kPixelRGBResv8BitPerColor:
+    return c.r | (c.g << 8) | (c.b << 16);
+  case kPixelBGRResv8BitPerColor:
+    return c.b | (c.g << 8) | (c.r << 16);
+  }
+  return 0;
+}
+
+/** @brief フレームバッファ上の1ピクセル（32ビット）の表現を色に戻す */
+inline PixelColor FromNativePixel(PixelFormat format, uint32_t value) {
+  const uint8_t lo = value & 0xff, mid = (value >> 8) & 0xff,
+                hi = (value >> 16) & 0xff;
+  switch (format) {
+  case kPixelRGBResv8BitPerColor:
+    return {lo, mid, hi};
+  case kPixelBGRResv8BitPerColor:
+    return {hi, mid, lo};
+  }
+  return {0, 0, 0};
+}
+
+/** @brief ネイティブ形式のピクセルを別の形式に変換する。上位 8 ビットは残す */
+inline uint32_t ConvertNativePixel(PixelFormat from, PixelFormat to,
+                                   uint32_t value) {
+  if (from == to) {
+    return value;
+  }
+  // RGB と BGR は下位 24 ビットの両端のバイトを入れ替えた関係にある
+  return (value & 0xff00ff00u) | ((value & 0xffu) << 16) |
+         ((value >> 16) & 0xffu);
+}
+
+/** @brief 不透明度を乗算済みのピクセル src を dst に重ねた値を返す
+ *
+ * src の上位 8 ビットを不透明度 a として，
+ * 各チャンネルを src + dst * (255 - a) / 255 とする。
+ * src と dst の下位 24 ビットは同じ形式でなければならない
+ */
+inline uint32_t BlendPremultiplied(uint32_t dst, uint32_t src) {
+  const uint32_t inv_alpha = 255 - (src >> 24);
+  uint32_t result = 0;
+  for (int shift = 0; shift < 24; shift += 8) {
+    const uint32_t x = ((dst >> shift) & 0xff) * inv_alpha + 128;
+    const uint32_t c = ((src >> shift) & 0xff) + ((x + (x >> 8)) >> 8);
+    result |= std::min<uint32_t>(c, 255) << shift;
+  }
+  return result;
+}
+
+// rectangle
+template <typename T> struct Rectangle { Vector2D<T> pos, size; };
+// rectangle
+
 // pixel_writer
 class PixelWriter {
 public:
@@ -48,6 +120,73 @@ public:
   virtual void Write(Vector2D<int> pos, const PixelColor &c) = 0;
   virtual int Width() const = 0;
   virtual int Height() const = 0;
+  /** @brief BlitRect で変換なしに書き込めるピクセル形式
+   *
+   * 書き込む側が転送元を用意するときの目安で，
+   * 他の形式で BlitRect を呼んでも正しく描画される
+   * */
+  virtual PixelFormat Format() const { return kPixelBGRResv8BitPerColor; }
+
+  /** @brief 矩形領域を指定された色で塗りつぶす
+   *
+   * 既定の実装は Write を1ピクセルずつ呼び出す。
+   * 派生クラスはまとめて書き込む実装で上書きできる
+   * */
+  virtual void FillRect(const Rectangle<int> &rect, const PixelColor &c) {
+    for (int dy = 0; dy < rect.size.y; ++dy) {
+      for (int dx = 0; dx < rect.size.x; ++dx) {
+        Write(rect.pos + Vector2D<int>{dx, dy}, c);
+      }
+    }
+  }
+  /** @brief pos から右へ length ピクセルを指定された色で塗りつぶす */
+  virtual void FillSpan(Vector2D<int> pos, int length, const PixelColor &c) {
+    FillRect({pos, {length, 1}}, c);
+  }
+  /** @brief pos から右へ length ピクセル分の色を colors から書き込む */
+  virtual void WriteSpan(Vector2D<int> pos, const PixelColor *colors,
+                         int length) {
+    for (int dx = 0; dx < length; ++dx) {
+      Write(pos + Vector2D<int>{dx, 0}, colors[dx]);
+    }
+  }
+  /** @brief ネイティブ形式のピクセルが並んだ矩形を pos へ書き込む
+   *
+   * @param pos  書き込み先の左上の座標
+   * @param src  転送元の左上のピクセル
+   * @param src_stride  転送元の1行のピクセル数
+   * @param size  転送する矩形の大きさ
+   * @param format  転送元のピクセル形式
+   * */
+  virtual void BlitRect(Vector2D<int> pos, const uint32_t *src, int src_stride,
+                        Vector2D<int> size, PixelFormat format) {
+    for (int dy = 0; dy < size.y; ++dy) {
+      for (int dx = 0; dx < size.x; ++dx) {
+        Write(pos + Vector2D<int>{dx, dy},
+              FromNativePixel(format, src[src_stride * dy + dx]));
+      }
+    }
+  }
+  /** @brief 不透明度を乗算済みのピクセルの並びを pos から右へ重ねる
+   *
+   * 各ピクセルの上位 8 ビットが不透明度で，下位 24 ビットが format の色。
+   * 既定の実装は描画先を読めないので，不透明度が半分以上のピクセルだけを
+   * 乗算前の色に戻して書き込む
+   * */
+  virtual void BlendSpan(Vector2D<int> pos, const uint32_t *src, int length,
+                         PixelFormat format) {
+    for (int dx = 0; dx < length; ++dx) {
+      const uint32_t alpha = src[dx] >> 24;
+      if (alpha < 128) {
+        continue;
+      }
+      const auto c = FromNativePixel(format, src[dx]);
+      Write(pos + Vector2D<int>{dx, 0},
+            {static_cast<uint8_t>(std::min<uint32_t>(c.r * 255 / alpha, 255)),
+             static_cast<uint8_t>(std::min<uint32_t>(c.g * 255 / alpha, 255)),
+             static_cast<uint8_t>(std::min<uint32_t>(c.b * 255 / alpha, 255))});
+    }
+  }
 };
 
 class FrameBufferWriter : public PixelWriter {
@@ -56,6 +195,26 @@ public:
   virtual ~FrameBufferWriter() = default;
   virtual int Width() const override { return config_.horizontal_resolution; }
   virtual int Height() const override { return config_.vertical_resolution; }
+  virtual PixelFormat Format() const override { return config_.pixel_format; }
+  /** @brief 描画範囲に収まる部分を行ごとにまとめて塗りつぶす */
+  virtual void FillRect(const Rectangle<int> &rect,
+                        const PixelColor &c) override;
+  virtual void FillSpan(Vector2D<int> pos, int length,
+                        const PixelColor &c) override;
+  virtual void WriteSpan(Vector2D<int> pos, const PixelColor *colors,
+                         int length) override;
+  /** @brief 描画範囲に収まる部分を転送する
+   *
+   * ピクセル形式が同じなら行ごとにまとめてコピーする
+   * */
+  virtual void BlitRect(Vector2D<int> pos, const uint32_t *src, int src_stride,
+                        Vector2D<int> size, PixelFormat format) override;
+  /** @brief 描画範囲に収まる部分を描画先のピクセルと重ねる
+   *
+   * ピクセル形式が同じなら行をまとめて blit_kernel で重ねる
+   * */
+  virtual void BlendSpan(Vector2D<int> pos, const uint32_t *src, int length,
+                         PixelFormat format) override;
 
 protected:
   uint8_t *PixelAt(Vector2D<int> pos) {
@@ -104,4 +263,24 @@ Vector2D<T> ElementMin(const Vector2D<T> &lhs, const Vector2D<T> &rhs) {
   return {std::min(lhs.x, rhs.x), std::min(lhs.y, rhs.y)};
 }
 
-template <typename T> struct Rectangle { Vector2D<T> pos, size; };
+// rectangle
+/** @brief 2つの矩形の共通部分を返す。重ならない場合は大きさ0の矩形を返す */
+template <typename T>
+Rectangle<T> operator&(const Rectangle<T> &lhs, const Rectangle<T> &rhs) {
+  const auto lhs_end = lhs.pos + lhs.size;
+  const auto rhs_end = rhs.pos + rhs.size;
+  if (lhs_end.x <= rhs.pos.x || lhs_end.y <= rhs.pos.y ||
+      rhs_end.x <= lhs.pos.x || rhs_end.y <= lhs.pos.y) {
+    return {{0, 0}, {0, 0}};
+  }
+
+  const auto new_pos = ElementMax(lhs.pos, rhs.pos);
+  const auto new_size = ElementMin(lhs_end, rhs_end) - new_pos;
+  return {new_pos, new_size};
+}
+
+/** @brief 矩形が1ピクセルも含まない場合に true を返す */
+template <typename T> bool IsEmpty(const Rectangle<T> &rect) {
+  return rect.size.x <= 0 || rect.size.y <= 0;
+}
+// rectangle
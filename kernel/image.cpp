@@ -0,0 +1,111 @@
+#include "image.hpp"
+
+#include <cstring>
+
+// utils
+namespace {
+const uint8_t kImageMagic[4] = {'I', 'M', 'G', '1'};
+const size_t kHeaderBytes = 12;
+/** @brief スパンの長さのうち，半透明なスパンであることを表すビット */
+const uint16_t kTranslucentSpan = 0x8000;
+
+uint16_t Read16(const uint8_t *p) {
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t Read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+} // namespace
+// utils
+
+// initialize
+Error Image::Initialize(const uint8_t *data, size_t size) {
+  data_ = nullptr;
+  if (size < kHeaderBytes || memcmp(data, kImageMagic, 4) != 0) {
+    return MAKE_ERROR(Error::kInvalidFormat);
+  }
+  // DrawTo はピクセルの並びを uint32_t の配列として描画関数へ渡す
+  if (reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+    return MAKE_ERROR(Error::kInvalidFormat);
+  }
+  const int width = Read16(data + 4);
+  const int height = Read16(data + 6);
+  const auto format = Read32(data + 8);
+  if (format != kPixelRGBResv8BitPerColor &&
+      format != kPixelBGRResv8BitPerColor) {
+    return MAKE_ERROR(Error::kUnknownPixelFormat);
+  }
+  if (kHeaderBytes + 4 * static_cast<size_t>(height) > size) {
+    return MAKE_ERROR(Error::kInvalidFormat);
+  }
+
+  for (int y = 0; y < height; ++y) {
+    size_t offset = Read32(data + kHeaderBytes + 4 * y);
+    if (offset + 4 > size) {
+      return MAKE_ERROR(Error::kInvalidFormat);
+    }
+    const int span_count = Read16(data + offset);
+    offset += 4;
+    for (int i = 0; i < span_count; ++i) {
+      if (offset + 4 > size) {
+        return MAKE_ERROR(Error::kInvalidFormat);
+      }
+      const int x = Read16(data + offset);
+      const int length = Read16(data + offset + 2) & ~kTranslucentSpan;
+      offset += 4 + 4 * static_cast<size_t>(length);
+      if (x + length > width || offset > size) {
+        return MAKE_ERROR(Error::kInvalidFormat);
+      }
+    }
+  }
+
+  data_ = data;
+  width_ = width;
+  height_ = height;
+  format_ = static_cast<PixelFormat>(format);
+  return MAKE_ERROR(Error::kSuccess);
+}
+// initialize
+
+// draw_to
+void Image::DrawTo(PixelWriter &writer, Vector2D<int> pos) const {
+  if (!IsValid()) {
+    return;
+  }
+  const int y_begin = std::max(0, -pos.y);
+  const int y_end = std::min(height_, writer.Height() - pos.y);
+  for (int y = y_begin; y < y_end; ++y) {
+    const uint8_t *p = data_ + Read32(data_ + kHeaderBytes + 4 * y);
+    const int span_count = Read16(p);
+    p += 4;
+    for (int i = 0; i < span_count; ++i) {
+      const int x = Read16(p);
+      const uint16_t length = Read16(p + 2);
+      // 行のデータは 4 バイト境界に揃えて並べてある
+      const auto pixels = reinterpret_cast<const uint32_t *>(p + 4);
+      const Vector2D<int> span_pos{pos.x + x, pos.y + y};
+      if (length & kTranslucentSpan) {
+        const int n = length & ~kTranslucentSpan;
+        writer.BlendSpan(span_pos, pixels, n, format_);
+        p += 4 + 4 * n;
+      } else {
+        writer.BlitRect(span_pos, pixels, length, {length, 1}, format_);
+        p += 4 + 4 * length;
+      }
+    }
+  }
+}
+// draw_to
+
+Error LoadEmbeddedImage(Image &image, const uint8_t *start,
+                        const uint8_t *end) {
+  if (image.IsValid()) {
+    return MAKE_ERROR(Error::kSuccess);
+  }
+  return image.Initialize(start, end - start);
+}
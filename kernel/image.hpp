@@ -0,0 +1,49 @@
+/**
+ * @file image.hpp
+ *
+ * tools/makeimage.py が生成してカーネルに埋め込んだ画像を扱う。
+ * 画像はネイティブ形式・不透明度乗算済みのピクセルを，透明な部分を除いた
+ * スパンの並びとして持っているので，描画のたびに展開する必要がない。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "error.hpp"
+#include "graphics.hpp"
+
+/** @brief 埋め込んだ画像。データは複製せず，埋め込まれた場所を直接参照する */
+class Image {
+public:
+  /** @brief size バイトの画像データ data を検査して使えるようにする
+   *
+   * 各行のスパンが画像の範囲に収まっていることだけを確かめ，
+   * ピクセルは変換しない。data は 4 バイト境界に置かれていなければならない
+   */
+  Error Initialize(const uint8_t *data, size_t size);
+  /** @brief Initialize に成功していれば true を返す */
+  bool IsValid() const { return data_ != nullptr; }
+  /** @brief 画像の大きさをピクセル単位で返す */
+  Vector2D<int> Size() const { return {width_, height_}; }
+
+  /** @brief 画像の左上が pos に来るように writer へ描く
+   *
+   * 不透明なスパンは BlitRect で転送し，半透明なスパンは BlendSpan で重ねる。
+   * 透明なピクセルには何も書かない。writer からはみ出した部分は描かない
+   */
+  void DrawTo(PixelWriter &writer, Vector2D<int> pos) const;
+
+private:
+  const uint8_t *data_{nullptr};
+  int width_{0}, height_{0};
+  PixelFormat format_{kPixelRGBResv8BitPerColor};
+};
+
+/** @brief objcopy で埋め込んだ画像ファイルの先頭と末尾から image を初期化する
+ *
+ * 初期化済みなら何もしない。使う直前に呼ぶことを想定している
+ */
+Error LoadEmbeddedImage(Image &image, const uint8_t *start,
+                        const uint8_t *end);
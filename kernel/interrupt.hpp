@@ -53,6 +53,7 @@ class InterruptVector {
 public:
   enum Number {
     kXHCI = 0x40,
+    kLAPICTimer = 0x41,
   };
 };
 // vector_numbers
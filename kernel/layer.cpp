@@ -1,8 +1,56 @@
 #include "layer.hpp"
 #include "frame_buffer.hpp"
+#include "logger.hpp"
 
 #include <algorithm>
 
+namespace {
+/** @brief 互いに重ならない矩形の集合 rects から矩形 cut の範囲を取り除く
+ *
+ * cut と重なる矩形は，cut の上下左右に残る最大4つの矩形に分割する
+ * */
+void SubtractRectangle(std::vector<Rectangle<int>> &rects,
+                       const Rectangle<int> &cut) {
+  const auto num_rects = rects.size();
+  for (size_t i = 0; i < num_rects; ++i) {
+    const auto rect = rects[i];
+    const auto overlap = rect & cut;
+    if (IsEmpty(overlap)) {
+      continue;
+    }
+    rects[i].size = {0, 0};
+
+    const auto rect_end = rect.pos + rect.size;
+    const auto overlap_end = overlap.pos + overlap.size;
+    if (rect.pos.y < overlap.pos.y) {
+      rects.push_back({rect.pos, {rect.size.x, overlap.pos.y - rect.pos.y}});
+    }
+    if (overlap_end.y < rect_end.y) {
+      rects.push_back({{rect.pos.x, overlap_end.y},
+                       {rect.size.x, rect_end.y - overlap_end.y}});
+    }
+    if (rect.pos.x < overlap.pos.x) {
+      rects.push_back({{rect.pos.x, overlap.pos.y},
+                       {overlap.pos.x - rect.pos.x, overlap.size.y}});
+    }
+    if (overlap_end.x < rect_end.x) {
+      rects.push_back({{overlap_end.x, overlap.pos.y},
+                       {rect_end.x - overlap_end.x, overlap.size.y}});
+    }
+  }
+  rects.erase(std::remove_if(rects.begin(), rects.end(),
+                             [](const auto &r) { return IsEmpty(r); }),
+              rects.end());
+}
+
+/** @brief 2つの矩形を両方とも含む最小の矩形を返す */
+Rectangle<int> BoundingBox(const Rectangle<int> &a, const Rectangle<int> &b) {
+  const auto pos = ElementMin(a.pos, b.pos);
+  const auto end = ElementMax(a.pos + a.size, b.pos + b.size);
+  return {pos, end - pos};
+}
+} // namespace
+
 // layer_ctor
 Layer::Layer(unsigned int id) : id_{id} {}
 // layer_ctor
@@ -19,6 +67,15 @@ Layer &Layer::SetWindow(const std::shared_ptr<Window> &window) {
 
 std::shared_ptr<Window> Layer::GetWindow() const { return window_; }
 
+Vector2D<int> Layer::GetPosition() const { return pos_; }
+
+Rectangle<int> Layer::GetArea() const {
+  if (!window_) {
+    return {pos_, {0, 0}};
+  }
+  return {pos_, window_->Size()};
+}
+
 // layer_setget_window
 
 // layer_move
@@ -33,40 +90,253 @@ Layer &Layer::MoveRelative(Vector2D<int> pos_diff) {
 }
 // layer_move
 
+Layer &Layer::SetAlpha(uint8_t alpha) {
+  alpha_ = alpha;
+  return *this;
+}
+
+uint8_t Layer::Alpha() const { return alpha_; }
+
+bool Layer::IsOpaque() const {
+  return alpha_ == 255 && window_ && window_->IsOpaque();
+}
+
 // layer_drawto
-void Layer::DrawTo(FrameBuffer &screen) const {
-  if (window_) {
-    window_->DrawTo(screen, pos_);
+void Layer::DrawTo(FrameBuffer &screen, const Rectangle<int> &area) const {
+  if (window_ && alpha_ > 0) {
+    window_->DrawTo(screen, pos_, area, alpha_);
   }
 }
 // layer_drawto
 
 // layermgr_setwriter
-void LayerManager::SetWriter(FrameBuffer *screen) { screen_ = screen; }
+void LayerManager::SetWriter(FrameBuffer *screen) {
+  screen_ = screen;
+
+  // 画面の大きさに合わせて格子を作り直す
+  auto &writer = screen_->Writer();
+  grid_size_ = {(writer.Width() + kGridCellSize - 1) / kGridCellSize,
+                (writer.Height() + kGridCellSize - 1) / kGridCellSize};
+  grid_.assign(grid_size_.x * grid_size_.y, {});
+  for (uint32_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].z_node) {
+      IndexLayer(i);
+    }
+  }
+}
 // layermgr_setwriter
 
 // layermgr_newlayer
 Layer &LayerManager::NewLayer() {
-  ++latest_id_;
-  return *layers_.emplace_back(new Layer{latest_id_});
+  uint32_t slot_index;
+  if (free_slots_.empty()) {
+    if (slots_.size() == kMaxSlots) {
+      Log(kError, "no free layer slot: %lu layers\n", slots_.size());
+      invalid_layer_ = Layer{};
+      return invalid_layer_;
+    }
+    slot_index = slots_.size();
+    slots_.push_back({nullptr, nullptr, 1, {}, 0});
+  } else {
+    slot_index = free_slots_.back();
+    free_slots_.pop_back();
+  }
+
+  auto &slot = slots_[slot_index];
+  const unsigned int id =
+      (static_cast<unsigned int>(slot.generation) << kSlotBits) | slot_index;
+  slot.layer.reset(new Layer{id});
+  return *slot.layer;
+}
+
+void LayerManager::RemoveLayer(unsigned int id) {
+  auto slot = FindSlot(id);
+  if (slot == nullptr) {
+    return;
+  }
+  if (slot->z_node) {
+    layer_stack_.Erase(slot->z_node);
+    slot->z_node = nullptr;
+    UnindexLayer(slot - slots_.data());
+    Draw(slot->layer->GetArea());
+  }
+  slot->layer.reset();
+  if (++slot->generation == 0) {
+    slot->generation = 1;
+  }
+  free_slots_.push_back(slot - slots_.data());
 }
 // layermgr_newlayer
 
 // layermgr_draw
-void LayerManager::Draw() const {
-  for (auto layer : layer_stack_) {
-    layer->DrawTo(*screen_);
+void LayerManager::Draw() {
+  auto &writer = screen_->Writer();
+  Draw({{0, 0}, {writer.Width(), writer.Height()}});
+}
+
+void LayerManager::Draw(const Rectangle<int> &area) {
+  Invalidate(area);
+}
+
+void LayerManager::Draw(unsigned int id) {
+  if (auto layer = FindLayer(id)) {
+    Draw(layer->GetArea());
+  }
+}
+
+void LayerManager::Draw(unsigned int id, const Rectangle<int> &area) {
+  if (auto layer = FindLayer(id)) {
+    const auto layer_area = layer->GetArea();
+    Draw(Rectangle<int>{layer_area.pos + area.pos, area.size} & layer_area);
   }
 }
 // layermgr_draw
 
+// layermgr_compose
+void LayerManager::Compose(const Rectangle<int> &area) {
+  auto &writer = screen_->Writer();
+  const auto draw_area = area & Rectangle<int>{{0, 0},
+                                               {writer.Width(), writer.Height()}};
+  if (IsEmpty(draw_area)) {
+    return;
+  }
+
+  // 最前面から順に，より上にある不透明なレイヤに隠されていない範囲を求める
+  std::vector<Rectangle<int>> uncovered{draw_area};
+  std::vector<std::pair<const Layer *, Rectangle<int>>> draw_list;
+  const auto slot_indices = QuerySlots(draw_area);
+  size_t visited = 0;
+  for (; visited < slot_indices.size() && !uncovered.empty(); ++visited) {
+    const auto layer = slots_[slot_indices[visited]].layer.get();
+    const auto layer_area = layer->GetArea();
+    const auto draw_list_size = draw_list.size();
+    for (const auto &rect : uncovered) {
+      const auto visible = layer_area & rect;
+      if (!IsEmpty(visible)) {
+        draw_list.push_back({layer, visible});
+      }
+    }
+    if (draw_list.size() > draw_list_size) {
+      ++drawn_layers_;
+    } else {
+      ++skipped_layers_;
+    }
+    if (layer->IsOpaque()) {
+      SubtractRectangle(uncovered, layer_area);
+    }
+  }
+  // 前面のレイヤで覆い尽くされたため調べなかったレイヤも描かずに済んだ
+  skipped_layers_ += slot_indices.size() - visited;
+
+  // 見えている範囲だけを背面から順に合成する
+  auto &back_buffer = screen_->BackBuffer();
+  for (auto it = draw_list.rbegin(); it != draw_list.rend(); ++it) {
+    it->first->DrawTo(back_buffer, it->second);
+    drawn_pixels_ += it->second.size.x * it->second.size.y;
+  }
+  // カーソルの下の内容が変わったので退避し直してカーソルを描く
+  DrawCursor(draw_area);
+  screen_->Present(draw_area);
+}
+// layermgr_compose
+
+// layermgr_cursor
+void LayerManager::SetCursor(const std::shared_ptr<Window> &window,
+                             Vector2D<int> pos) {
+  auto &back_buffer = screen_->BackBuffer();
+  const auto old_area = CursorArea();
+  if (cursor_) {
+    back_buffer.Copy(cursor_pos_, cursor_under_);
+  }
+
+  cursor_ = window;
+  cursor_pos_ = pos;
+  if (cursor_) {
+    FrameBufferConfig config{};
+    config.frame_buffer = nullptr;
+    config.horizontal_resolution = cursor_->Width();
+    config.vertical_resolution = cursor_->Height();
+    config.pixel_format = screen_->Config().pixel_format;
+    if (auto err = cursor_under_.Initialize(config)) {
+      Log(kError, "failed to initialize cursor buffer: %s at %s:%d\n",
+          err.Name(), err.File(), err.Line());
+      cursor_.reset();
+    }
+  }
+  DrawCursor(CursorArea());
+  screen_->Present(old_area);
+  screen_->Present(CursorArea());
+}
+
+void LayerManager::MoveCursor(Vector2D<int> pos) {
+  if (!cursor_) {
+    return;
+  }
+  const auto old_area = CursorArea();
+  screen_->BackBuffer().Copy(cursor_pos_, cursor_under_);
+  cursor_pos_ = pos;
+  DrawCursor(CursorArea());
+  screen_->Present(old_area);
+  screen_->Present(CursorArea());
+}
+
+Rectangle<int> LayerManager::CursorArea() const {
+  if (!cursor_) {
+    return {cursor_pos_, {0, 0}};
+  }
+  return {cursor_pos_, cursor_->Size()};
+}
+
+void LayerManager::DrawCursor(const Rectangle<int> &area) {
+  auto &back_buffer = screen_->BackBuffer();
+  const auto &writer = screen_->Writer();
+  const Rectangle<int> screen_area{{0, 0}, {writer.Width(), writer.Height()}};
+  const auto overlap = area & CursorArea() & screen_area;
+  if (IsEmpty(overlap)) {
+    return;
+  }
+  cursor_under_.Copy(overlap.pos - cursor_pos_, back_buffer, overlap);
+  cursor_->DrawTo(back_buffer, cursor_pos_, overlap);
+  drawn_pixels_ += overlap.size.x * overlap.size.y;
+}
+// layermgr_cursor
+
 // layermgr_move
 void LayerManager::Move(unsigned int id, Vector2D<int> new_position) {
-  FindLayer(id)->Move(new_position);
+  auto layer = FindLayer(id);
+  if (layer == nullptr) {
+    return;
+  }
+  MoveRelative(id, new_position - layer->GetPosition());
 }
 
 void LayerManager::MoveRelative(unsigned int id, Vector2D<int> pos_diff) {
-  FindLayer(id)->MoveRelative(pos_diff);
+  auto slot = FindSlot(id);
+  if (slot == nullptr) {
+    return;
+  }
+  const uint32_t slot_index = slot - slots_.data();
+  const bool visible = slot->z_node != nullptr;
+  if (visible) {
+    UnindexLayer(slot_index);
+  }
+  const auto old_area = slot->layer->GetArea();
+  slot->layer->MoveRelative(pos_diff);
+  if (visible) {
+    IndexLayer(slot_index);
+  }
+  DrawMoved(old_area, slot->layer->GetArea());
+}
+
+void LayerManager::DrawMoved(const Rectangle<int> &old_area,
+                             const Rectangle<int> &new_area) {
+  // 少しだけ移動した場合は2回に分けるより外接矩形を1回描く方が安い
+  if (IsEmpty(old_area & new_area)) {
+    Draw(old_area);
+    Draw(new_area);
+    return;
+  }
+  Draw(BoundingBox(old_area, new_area));
 }
 // layermgr_move
 
@@ -77,47 +347,216 @@ void LayerManager::UpDown(unsigned int id, int new_height) {
     return;
   }
 
-  if (new_height > layer_stack_.size()) {
-    new_height = layer_stack_.size();
+  auto slot = FindSlot(id);
+  if (slot == nullptr) {
+    return;
   }
 
-  auto layer = FindLayer(id);
-  auto old_pos = std::find(layer_stack_.begin(), layer_stack_.end(), layer);
-  auto new_pos = layer_stack_.begin() + new_height;
-
-  if (old_pos == layer_stack_.end()) {
-    layer_stack_.insert(new_pos, layer);
+  // 非表示のレイヤは現在の列に挿入し，表示中のレイヤは一度外してから入れ直す
+  if (slot->z_node == nullptr) {
+    slot->z_node = layer_stack_.Insert(slot->layer.get(), new_height);
+    IndexLayer(slot - slots_.data());
+    Invalidate(slot->layer->GetArea());
     return;
   }
-
-  if (new_pos == layer_stack_.end()) {
-    --new_pos;
+  const size_t max_height = layer_stack_.Size() - 1;
+  const size_t height = std::min<size_t>(new_height, max_height);
+  if (layer_stack_.HeightOf(slot->z_node) == height) {
+    return;
   }
-  layer_stack_.erase(old_pos);
-  layer_stack_.insert(new_pos, layer);
+  layer_stack_.Move(slot->z_node, height);
+  Invalidate(slot->layer->GetArea());
 }
 // layermgr_updown
 
 // layer_hide
 void LayerManager::Hide(unsigned int id) {
-  auto layer = FindLayer(id);
-  auto pos = std::find(layer_stack_.begin(), layer_stack_.end(), layer);
-  if (pos != layer_stack_.end()) {
-    layer_stack_.erase(pos);
+  auto slot = FindSlot(id);
+  if (slot && slot->z_node) {
+    layer_stack_.Erase(slot->z_node);
+    slot->z_node = nullptr;
+    UnindexLayer(slot - slots_.data());
+    Invalidate(slot->layer->GetArea());
   }
 }
 // layer_hide
 
+// layermgr_spatial_index
+Layer *LayerManager::FindLayerByPosition(Vector2D<int> pos,
+                                         unsigned int exclude_id) {
+  for (const auto slot_index : QuerySlots({pos, {1, 1}})) {
+    const auto layer = slots_[slot_index].layer.get();
+    if (layer->ID() != exclude_id) {
+      return layer;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<Layer *>
+LayerManager::FindLayersInArea(const Rectangle<int> &area) {
+  std::vector<Layer *> layers;
+  for (const auto slot_index : QuerySlots(area)) {
+    layers.push_back(slots_[slot_index].layer.get());
+  }
+  return layers;
+}
+
+void LayerManager::IndexLayer(uint32_t slot_index) {
+  auto &slot = slots_[slot_index];
+  slot.indexed_area = slot.layer->GetArea();
+  const auto cells = GridCells(slot.indexed_area);
+  for (int y = cells.pos.y; y < cells.pos.y + cells.size.y; ++y) {
+    for (int x = cells.pos.x; x < cells.pos.x + cells.size.x; ++x) {
+      grid_[grid_size_.x * y + x].push_back(slot_index);
+    }
+  }
+}
+
+void LayerManager::UnindexLayer(uint32_t slot_index) {
+  const auto cells = GridCells(slots_[slot_index].indexed_area);
+  for (int y = cells.pos.y; y < cells.pos.y + cells.size.y; ++y) {
+    for (int x = cells.pos.x; x < cells.pos.x + cells.size.x; ++x) {
+      auto &cell = grid_[grid_size_.x * y + x];
+      auto it = std::find(cell.begin(), cell.end(), slot_index);
+      if (it != cell.end()) {
+        *it = cell.back();
+        cell.pop_back();
+      }
+    }
+  }
+}
+
+Rectangle<int> LayerManager::GridCells(const Rectangle<int> &area) const {
+  const Rectangle<int> grid_area{
+      {0, 0}, {kGridCellSize * grid_size_.x, kGridCellSize * grid_size_.y}};
+  const auto clipped = area & grid_area;
+  if (IsEmpty(clipped)) {
+    return {{0, 0}, {0, 0}};
+  }
+  const Vector2D<int> begin{clipped.pos.x / kGridCellSize,
+                            clipped.pos.y / kGridCellSize};
+  const Vector2D<int> end{
+      (clipped.pos.x + clipped.size.x - 1) / kGridCellSize + 1,
+      (clipped.pos.y + clipped.size.y - 1) / kGridCellSize + 1};
+  return {begin, end - begin};
+}
+
+std::vector<uint32_t>
+LayerManager::QuerySlots(const Rectangle<int> &area) {
+  auto &writer = screen_->Writer();
+  const auto query_area =
+      area & Rectangle<int>{{0, 0}, {writer.Width(), writer.Height()}};
+
+  // 複数のマスにまたがるレイヤは印を付けて1度だけ数える
+  ++query_stamp_;
+  std::vector<std::pair<size_t, uint32_t>> found;
+  const auto cells = GridCells(query_area);
+  for (int y = cells.pos.y; y < cells.pos.y + cells.size.y; ++y) {
+    for (int x = cells.pos.x; x < cells.pos.x + cells.size.x; ++x) {
+      for (const auto slot_index : grid_[grid_size_.x * y + x]) {
+        auto &slot = slots_[slot_index];
+        if (slot.query_stamp == query_stamp_ ||
+            IsEmpty(slot.indexed_area & query_area)) {
+          continue;
+        }
+        slot.query_stamp = query_stamp_;
+        found.push_back({layer_stack_.HeightOf(slot.z_node), slot_index});
+      }
+    }
+  }
+
+  std::sort(found.begin(), found.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+  std::vector<uint32_t> slot_indices;
+  for (const auto &f : found) {
+    slot_indices.push_back(f.second);
+  }
+  return slot_indices;
+}
+// layermgr_spatial_index
+
+unsigned long LayerManager::DrawnPixels() const { return drawn_pixels_; }
+
+unsigned long LayerManager::DrawnLayers() const { return drawn_layers_; }
+
+unsigned long LayerManager::SkippedLayers() const { return skipped_layers_; }
+
+// layermgr_damage
+void LayerManager::SetDeferred(bool deferred) {
+  deferred_ = deferred;
+  if (!deferred_) {
+    ComposeFrame();
+  }
+}
+
+void LayerManager::Invalidate(const Rectangle<int> &area) {
+  if (!deferred_) {
+    Compose(area);
+    return;
+  }
+
+  auto &writer = screen_->Writer();
+  auto rect = area & Rectangle<int>{{0, 0}, {writer.Width(), writer.Height()}};
+  if (IsEmpty(rect)) {
+    return;
+  }
+
+  // 重なる範囲はまとめ，記録した範囲どうしが重ならないようにする
+  for (size_t i = 0; i < damage_.size();) {
+    if (IsEmpty(damage_[i] & rect)) {
+      ++i;
+      continue;
+    }
+    rect = BoundingBox(damage_[i], rect);
+    damage_[i] = damage_.back();
+    damage_.pop_back();
+    i = 0;
+  }
+  damage_.push_back(rect);
+
+  if (damage_.size() > kMaxDamageRects) {
+    for (const auto &r : damage_) {
+      rect = BoundingBox(rect, r);
+    }
+    damage_.clear();
+    damage_.push_back(rect);
+  }
+}
+
+bool LayerManager::ComposeFrame() {
+  if (damage_.empty()) {
+    return false;
+  }
+  for (const auto &rect : damage_) {
+    Compose(rect);
+  }
+  damage_.clear();
+  return true;
+}
+// layermgr_damage
+
 // layermgr_findlayer
-Layer *LayerManager::FindLayer(unsigned int id) {
-  auto pred = [id](const std::unique_ptr<Layer> &elem) {
-    return elem->ID() == id;
-  };
-  auto it = std::find_if(layers_.begin(), layers_.end(), pred);
-  if (it == layers_.end()) {
-    return nullptr;
-  }
-  return it->get();
+int LayerManager::SlotIndex(unsigned int id) const {
+  const auto index = id & ((1u << kSlotBits) - 1);
+  if (index >= slots_.size()) {
+    return -1;
+  }
+  const auto &slot = slots_[index];
+  if (!slot.layer || slot.generation != (id >> kSlotBits)) {
+    return -1;
+  }
+  return index;
+}
+
+LayerManager::LayerSlot *LayerManager::FindSlot(unsigned int id) {
+  const auto index = SlotIndex(id);
+  return index < 0 ? nullptr : &slots_[index];
+}
+
+Layer *LayerManager::FindLayer(unsigned int id) const {
+  const auto index = SlotIndex(id);
+  return index < 0 ? nullptr : slots_[index].layer.get();
 }
 // layermgr_findlayer
 
@@ -6,6 +6,7 @@
 #include "frame_buffer.hpp"
 #include "graphics.hpp"
 #include "window.hpp"
+#include "zorder.hpp"
 
 // layer
 /** @brief Layerは1つの層を表す
@@ -23,6 +24,10 @@ public:
   Layer &SetWindow(const std::shared_ptr<Window> &window);
   /** @brief 設定されたウィンドウを返す*/
   std::shared_ptr<Window> GetWindow() const;
+  /** @brief レイヤの原点座標を取得する */
+  Vector2D<int> GetPosition() const;
+  /** @brief レイヤが画面上で占める矩形領域を返す。ウィンドウが無ければ大きさ0 */
+  Rectangle<int> GetArea() const;
 
   /** @brief レイヤの位置情報を指定された絶対座標へと更新する。再描画はしない */
   Layer &Move(Vector2D<int> pos);
@@ -30,13 +35,26 @@ public:
   /** @brief レイヤの位置情報を指定された相対座標へと更新する。再描画はしない */
   Layer &MoveRelative(Vector2D<int> pos_diff);
 
-  /** @brief 指定された描画先にウィンドウの内容を描画する */
-  void DrawTo(FrameBuffer &screen) const;
+  /** @brief レイヤ全体の不透明度を設定する。再描画はしない
+   *
+   * 255 で不透明，0 で完全に透明になる。ウィンドウがピクセルごとの
+   * 不透明度を持つ場合は両者を掛け合わせる
+   * */
+  Layer &SetAlpha(uint8_t alpha);
+  /** @brief レイヤ全体の不透明度を返す */
+  uint8_t Alpha() const;
+
+  /** @brief レイヤが背面のレイヤを完全に隠す場合に true を返す */
+  bool IsOpaque() const;
+
+  /** @brief 指定された描画先の指定された範囲にウィンドウの内容を描画する */
+  void DrawTo(FrameBuffer &screen, const Rectangle<int> &area) const;
 
 private:
   unsigned int id_;
   Vector2D<int> pos_;
   std::shared_ptr<Window> window_;
+  uint8_t alpha_{255};
 };
 // layer
 
@@ -44,21 +62,61 @@ private:
 /** brief LayerManagerは複数のLayerを管理する */
 class LayerManager {
 public:
-  /** @brief Drawメソッドなどで描画する際の描画先を設定する */
+  /** @brief Drawメソッドなどで描画する際の描画先を設定する
+   *
+   * screen にバックバッファがあればそこで合成し，変化した部分だけを
+   * screen へ転送する
+   * */
   void SetWriter(FrameBuffer *screen);
 
   /** @brief 新しいレイヤを生成して参照を返す
    * 新しく生成されたレイヤの実態はLayerManager内部のコンテナで保持される
+   *
+   * レイヤの ID は格納位置と世代番号を組み合わせたもので，
+   * 削除されたレイヤの ID は再利用された格納位置の新しいレイヤとは一致しない。
+   * 格納位置を使い切った場合はエラーを記録し，どのレイヤにも対応しない
+   * ID 0 のレイヤを返す。これに対する操作は LayerManager に反映されない
    * */
   Layer &NewLayer();
+  /** @brief レイヤを削除してメモリを解放する。表示されていた範囲は再描画する
+   *
+   * 削除した後は，そのレイヤの ID を渡しても何もしない
+   * */
+  void RemoveLayer(unsigned int id);
 
-  /** @brief 現在表示状態にあるレイヤを描画する*/
-  void Draw() const;
+  /** @brief 現在表示状態にあるレイヤを画面全体に描画する*/
+  void Draw();
+  /** @brief 現在表示状態にあるレイヤのうち，指定された範囲だけを描画する
+   *
+   * 上にある不透明なレイヤに隠された部分は描画しないため，
+   * 合成にかかる手間は見えているピクセル数に比例する。
+   * SetDeferred(true) の間は範囲を記録するだけで，描画は ComposeFrame で行う
+   *
+   * @param area 画面の左上を基準とした再描画範囲
+   * */
+  void Draw(const Rectangle<int> &area);
+  /** @brief 指定されたレイヤが占める範囲を再描画する
+   *
+   * レイヤの内容が変化したときに呼び出す。範囲内にある他のレイヤも
+   * 重なり順に従って描き直す
+   * */
+  void Draw(unsigned int id);
+  /** @brief 指定されたレイヤのうち area の部分を再描画する
+   *
+   * @param area レイヤの左上を基準とした再描画範囲
+   * */
+  void Draw(unsigned int id, const Rectangle<int> &area);
 
-  /** @brief レイヤの位置情報を指定された絶対場へと更新する 再描画はしない */
+  /** @brief レイヤの位置情報を指定された絶対座標へと更新し，
+   * 移動前と移動後の範囲を再描画する
+   *
+   * 表示中のレイヤは Layer::Move ではなくこちらで動かす。
+   * 位置による検索に使う索引もここで更新する
+   * */
   void Move(unsigned int id, Vector2D<int> new_position);
 
-  /** @brief レイヤの位置情報を指定された相対場へと更新する 再描画はしない */
+  /** @brief レイヤの位置情報を指定された相対座標へと更新し，
+   * 移動前と移動後の範囲を再描画する */
   void MoveRelative(unsigned int id, Vector2D<int> pos_diff);
 
   /** @brief レイヤの高さ方向の位置を指定された位置に移動する
@@ -66,18 +124,140 @@ public:
    * new_heightに負の高さを指定するとレイヤは非表示となり，
    * 0以上を指定するとその高さになる
    * 現在のレイヤ数以上の数値を指定した場合は最前面のレイヤとなる
+   * 表示状態や重なり順が変わったときはレイヤの範囲を再描画する
    * */
   void UpDown(unsigned int id, int new_height);
-  /** @brief レイヤを非表示にする */
+  /** @brief レイヤを非表示にし，隠れていた範囲を再描画する */
   void Hide(unsigned int id);
 
+  /** @brief 指定された位置にある最前面のレイヤを返す
+   *
+   * 表示中のレイヤのうち，範囲が pos を含むものを探す。透過色は考慮しない
+   *
+   * @param pos 画面の左上を基準とした位置
+   * @param exclude_id このレイヤは除いて探す
+   * @return 見つからなければ nullptr
+   * */
+  Layer *FindLayerByPosition(Vector2D<int> pos, unsigned int exclude_id);
+  /** @brief 表示中のレイヤのうち，範囲が area と重なるものを
+   * 前面にあるものから順に返す。画面の外にはみ出した部分は考慮しない
+   *
+   * @param area 画面の左上を基準とした範囲
+   * */
+  std::vector<Layer *> FindLayersInArea(const Rectangle<int> &area);
+
+  /** @brief マウスカーソルのように最前面に重ねて描くウィンドウを設定する
+   *
+   * カーソルはレイヤとしては扱わず，合成後のバックバッファに直接描く。
+   * カーソルを描く前にその下の内容を別のバッファに退避しておく
+   * */
+  void SetCursor(const std::shared_ptr<Window> &window, Vector2D<int> pos);
+  /** @brief カーソルを移動してすぐに画面へ反映する
+   *
+   * 移動前の範囲は退避しておいた内容で書き戻し，移動後の範囲を退避してから
+   * カーソルを描く。レイヤは合成し直さないため，手間はレイヤの数に依らない。
+   * 描画を後回しにする設定でもすぐに反映する
+   * */
+  void MoveCursor(Vector2D<int> pos);
+
+  /** @brief これまでの描画処理で書き込んだピクセル数の累計を返す（性能計測用）
+   */
+  unsigned long DrawnPixels() const;
+  /** @brief これまでの合成で，範囲と重なり実際に描いたレイヤの数の累計を返す
+   *
+   * 1回の合成で描いたレイヤを1つと数える（性能計測用）
+   */
+  unsigned long DrawnLayers() const;
+  /** @brief これまでの合成で，範囲と重なるが前面のレイヤに隠されていたため
+   * 描かなかったレイヤの数の累計を返す（性能計測用） */
+  unsigned long SkippedLayers() const;
+
+  /** @brief 描画を後回しにするかどうかを設定する
+   *
+   * true にすると Draw や Move は画面を描き直さず，再描画が必要な範囲を
+   * 記録するだけになる。記録した範囲は ComposeFrame でまとめて描画する
+   * */
+  void SetDeferred(bool deferred);
+  /** @brief 再描画が必要な範囲を記録する。後回しにしない設定ならすぐに描画する
+   *
+   * @param area 画面の左上を基準とした再描画範囲
+   * */
+  void Invalidate(const Rectangle<int> &area);
+  /** @brief 記録しておいた範囲を描画する
+   *
+   * @return 描画した範囲があれば true
+   * */
+  bool ComposeFrame();
+
 private:
+  /** @brief 記録しておく再描画範囲の最大数。超えたら外接矩形1つにまとめる */
+  static const size_t kMaxDamageRects = 16;
+
   FrameBuffer *screen_{nullptr};
-  std::vector<std::unique_ptr<Layer>> layers_{};
-  std::vector<Layer *> layer_stack_{};
-  unsigned int latest_id_{0};
+  unsigned long drawn_pixels_{0};
+  unsigned long drawn_layers_{0}, skipped_layers_{0};
+  bool deferred_{false};
+  std::vector<Rectangle<int>> damage_{};
+  std::shared_ptr<Window> cursor_{};
+  Vector2D<int> cursor_pos_{};
+  /** @brief カーソルの下にある，カーソルを描く前の内容 */
+  FrameBuffer cursor_under_{};
+  /** @brief レイヤ ID のうち格納位置を表すビット数
+   *
+   * 上位の 16 ビットは LayerSlot::generation を入れる */
+  static const int kSlotBits = 16;
+  static const size_t kMaxSlots = size_t{1} << kSlotBits;
+
+  /** @brief レイヤの格納位置 */
+  struct LayerSlot {
+    std::unique_ptr<Layer> layer;
+    /** @brief 表示されていれば重なり順の中のノード，非表示なら nullptr */
+    ZOrder::Node *z_node;
+    /** @brief 格納位置が再利用されるたびに増える番号。0 は使わない */
+    uint16_t generation;
+    /** @brief 索引に登録したときのレイヤの範囲 */
+    Rectangle<int> indexed_area;
+    /** @brief 検索で同じレイヤを2度数えないための印 */
+    unsigned long query_stamp;
+  };
+
+  std::vector<LayerSlot> slots_{};
+  /** @brief 空いている格納位置の一覧 */
+  std::vector<uint32_t> free_slots_{};
+  ZOrder layer_stack_{};
+  /** @brief 格納位置を使い切ったときに NewLayer が返す，登録されないレイヤ */
+  Layer invalid_layer_{};
+
+  /** @brief 位置による検索に使う格子の1マスの大きさ（ピクセル） */
+  static const int kGridCellSize = 64;
+  /** @brief 画面を kGridCellSize ごとに区切った格子。各マスには
+   * そのマスと重なる表示中のレイヤの格納位置を入れる */
+  std::vector<std::vector<uint32_t>> grid_{};
+  Vector2D<int> grid_size_{0, 0};
+  unsigned long query_stamp_{0};
 
-  Layer *FindLayer(unsigned int id);
+  /** @brief ID に対応する格納位置の添字を返す。ID が古ければ -1 を返す */
+  int SlotIndex(unsigned int id) const;
+  LayerSlot *FindSlot(unsigned int id);
+  Layer *FindLayer(unsigned int id) const;
+  /** @brief 表示中のレイヤを現在の範囲で索引に登録する */
+  void IndexLayer(uint32_t slot_index);
+  /** @brief 索引からレイヤを取り除く */
+  void UnindexLayer(uint32_t slot_index);
+  /** @brief area と重なる格子のマスの範囲を返す */
+  Rectangle<int> GridCells(const Rectangle<int> &area) const;
+  /** @brief area と重なる表示中のレイヤの格納位置を前面から順に返す */
+  std::vector<uint32_t> QuerySlots(const Rectangle<int> &area);
+  /** @brief 指定された範囲を合成して画面へ転送する */
+  void Compose(const Rectangle<int> &area);
+  /** @brief カーソルが画面上で占める矩形領域を返す */
+  Rectangle<int> CursorArea() const;
+  /** @brief バックバッファの area の範囲にあるカーソルの下の内容を退避し，
+   * その上にカーソルを描く */
+  void DrawCursor(const Rectangle<int> &area);
+  /** @brief 移動前後の範囲をまとめて再描画する */
+  void DrawMoved(const Rectangle<int> &old_area,
+                 const Rectangle<int> &new_area);
 };
 
 extern LayerManager *layer_manager;
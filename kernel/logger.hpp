@@ -15,6 +15,9 @@ enum LogLevel {
  * */
 void SetLogLevel(LogLevel level);
 
+/** @brief 現在のログ優先度のしきい値を返す */
+LogLevel GetLogLevel();
+
 /** @brief ログを指定された優先度で記録する
  *
  * 指定された優先度がしきい値以上なら記録する
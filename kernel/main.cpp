@@ -6,9 +6,12 @@
 #include <vector>
 
 #include "asmfunc.h"
+#include "blit.hpp"
+#include "bochs_display.hpp"
 #include "console.hpp"
 #include "error.hpp"
 #include "font.hpp"
+#include "frame_scheduler.hpp"
 #include "frame_buffer.hpp"
 #include "frame_buffer_config.hpp"
 #include "graphics.hpp"
@@ -22,12 +25,15 @@
 #include "pci.hpp"
 #include "queue.hpp"
 #include "segment.hpp"
+#include "stats_overlay.hpp"
 #include "timer.hpp"
+#include "usb/classdriver/keyboard.hpp"
 #include "usb/classdriver/mouse.hpp"
 #include "usb/device.hpp"
 #include "usb/memory.hpp"
 #include "usb/xhci/trb.hpp"
 #include "usb/xhci/xhci.hpp"
+#include "virtio/gpu.hpp"
 #include "window.hpp"
 
 // void operator delete(void *obj) noexcept {}
@@ -66,9 +72,11 @@ BitMapMemoryManager *memory_manager;
 // memman_buf
 
 // layermgr_mouse_observer
-unsigned int mouse_layer_id;
+FrameBuffer *screen;
 Vector2D<int> screen_size;
 Vector2D<int> mouse_position;
+/** @brief 処理中の xHCI 割り込みが起きたときの TSC の値。入力の時刻に使う */
+uint64_t xhci_interrupt_tsc;
 
 void MouseObserver(std::int8_t displacement_x, int8_t displacement_y) {
   auto newpos = mouse_position + Vector2D<int>{displacement_x, displacement_y};
@@ -78,15 +86,27 @@ void MouseObserver(std::int8_t displacement_x, int8_t displacement_y) {
   // 左端対策
   mouse_position = ElementMax(newpos, Vector2D<int>{0, 0});
 
-  layer_manager->Move(mouse_layer_id, mouse_position);
-  // StartLAPICTimer();
-  layer_manager->Draw();
-  // auto elapsed = LAPICTimerElapsed();
-  // StopLAPICTimer();
-  // printk("MouseObserver: elapsed = %u\n", elapsed);
+  // カーソルは他のレイヤを合成し直さずにすぐ描き直す
+  layer_manager->MoveCursor(mouse_position);
+  if (frame_scheduler) {
+    frame_scheduler->NoteInput(xhci_interrupt_tsc);
+    frame_scheduler->NotePresented();
+  }
 }
 // layermgr_mouse_observer
 
+// keyboard_observer
+void KeyboardObserver(uint8_t keycode) {
+  if (keycode == StatsOverlay::kToggleKey && stats_overlay) {
+    // 表示の切り替えは次のフレームで画面に反映される
+    if (frame_scheduler) {
+      frame_scheduler->NoteInput(xhci_interrupt_tsc);
+    }
+    stats_overlay->Toggle();
+  }
+}
+// keyboard_observer
+
 // switch_echi2xhci
 void SwitchEhci2Xhci(const pci::Device &xhc_dev) {
   bool intel_ehc_exist = false;
@@ -114,7 +134,10 @@ void SwitchEhci2Xhci(const pci::Device &xhc_dev) {
 struct Message {
   enum Type {
     kInterruptXHCI,
+    kInterruptLAPICTimer,
   } type;
+  /** @brief 割り込みが起きたときの TSC の値 */
+  uint64_t tsc;
 };
 
 ArrayQueue<Message> *main_queue;
@@ -124,11 +147,23 @@ ArrayQueue<Message> *main_queue;
 usb::xhci::Controller *xhc;
 
 __attribute__((interrupt)) void IntHandlerXHCI(InterruptFrame *frame) {
-  main_queue->Push(Message{Message::kInterruptXHCI});
+  main_queue->Push(Message{Message::kInterruptXHCI, ReadTSC()});
   NotifyEndOfInterrupt();
 }
 // xhci_handler
 
+// lapic_timer_handler
+char frame_scheduler_buf[sizeof(FrameScheduler)];
+char bochs_display_buf[sizeof(BochsDisplay)];
+char virtio_gpu_buf[sizeof(virtio::Gpu)];
+char stats_overlay_buf[sizeof(StatsOverlay)];
+
+__attribute__((interrupt)) void IntHandlerLAPICTimer(InterruptFrame *frame) {
+  main_queue->Push(Message{Message::kInterruptLAPICTimer});
+  NotifyEndOfInterrupt();
+}
+// lapic_timer_handler
+
 // main_new_stack
 
 alignas(16) uint8_t kernel_main_stack[1024 * 1024];
@@ -159,6 +194,8 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
   printk("Welcome to MikanOS!\n");
   SetLogLevel(kWarn);
   InitializeLAPICTimer();
+  Log(kInfo, "LAPIC timer: %lu Hz, TSC: %lu Hz\n", LAPICTimerFrequency(),
+      TSCFrequency());
 
   // setup_segments_and_page
   SetupSegments();
@@ -171,6 +208,16 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
   SetupIdentityPageTable();
   // setup_segments_and_page
 
+  // set_memory_types
+  // フレームバッファへの書き込みはまとめて転送し，LAPIC のレジスタは
+  // キャッシュせずに読み書きする
+  SetCacheType(reinterpret_cast<uint64_t>(frame_buffer_config.frame_buffer),
+                4 * frame_buffer_config.pixels_per_scan_line *
+                    frame_buffer_config.vertical_resolution,
+                CacheType::kWriteCombining);
+  SetCacheType(0xfee00000, 4096, CacheType::kUncached);
+  // set_memory_types
+
   // mark_allocated
   ::memory_manager = new (memory_manager_buf) BitMapMemoryManager;
 
@@ -214,6 +261,12 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
   }
   // initialize_heap
 
+  InitializeBlitKernel();
+  Log(kInfo, "blit kernel: %s\n", blit_kernel->name);
+  if (GetLogLevel() >= kDebug) {
+    BenchmarkBlitKernels();
+  }
+
   std::array<Message, 32> main_queue_data;
   ArrayQueue<Message> main_queue{main_queue_data};
   ::main_queue = &main_queue;
@@ -257,6 +310,9 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
   SetIDTEntry(idt[InterruptVector::kXHCI],
               MakeIDTAttr(DescriptorType::kInterruptGate, 0),
               reinterpret_cast<uint64_t>(IntHandlerXHCI), kernel_cs);
+  SetIDTEntry(idt[InterruptVector::kLAPICTimer],
+              MakeIDTAttr(DescriptorType::kInterruptGate, 0),
+              reinterpret_cast<uint64_t>(IntHandlerLAPICTimer), kernel_cs);
   LoadIDT(sizeof(idt) - 1, reinterpret_cast<uintptr_t>(&idt[0]));
   // load_idt
 
@@ -273,6 +329,7 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
   Log(kDebug, "ReadBar:%s\n", xhc_bar.error.Name());
   const uint64_t xhc_mmio_base = xhc_bar.value & ~static_cast<uint64_t>(0xf);
   Log(kDebug, "xHC mmio_base = %08lx\n", xhc_mmio_base);
+  SetCacheType(xhc_mmio_base, 64 * 1024, CacheType::kUncached);
   // read_bar
 
   // init_xhc
@@ -296,6 +353,7 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
 
   // configure port
   usb::HIDMouseDriver::default_observer = MouseObserver;
+  usb::HIDKeyboardDriver::default_observer = KeyboardObserver;
 
   for (int i = 1; i <= xhc.MaxPorts(); ++i) {
     auto port = xhc.PortAt(i);
@@ -316,23 +374,28 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
   screen_size.y = frame_buffer_config.vertical_resolution;
 
   auto bgwindow = std::make_shared<Window>(screen_size.x, screen_size.y,
-                                           frame_buffer_config.pixel_format);
+                                           frame_buffer_config.pixel_format,
+                                           Window::Surface::kIndexed);
 
   auto bgwriter = bgwindow->Writer();
 
   DrawDesktop(*bgwriter);
-  console->SetWindow(bgwindow);
-  console->SetWriter(bgwriter);
+
+  auto console_window = std::make_shared<Window>(
+      Console::kColumns * 8, Console::kRows * 16,
+      frame_buffer_config.pixel_format, Window::Surface::kIndexed);
+  console->SetWindow(console_window);
 
   auto mouse_window = std::make_shared<Window>(
-      kMouseCursorWidth, kMouseCursorHeight, frame_buffer_config.pixel_format);
+      kMouseCursorWidth, kMouseCursorHeight, frame_buffer_config.pixel_format,
+      Window::Surface::kIndexed);
   mouse_window->SetTransparentColor(kMouseTransparentColor);
   DrawMouseCursor(mouse_window->Writer(), {0, 0});
   mouse_position = {200, 200};
 
   // make_window
-  auto main_window =
-      std::make_shared<Window>(160, 52, frame_buffer_config.pixel_format);
+  auto main_window = std::make_shared<Window>(
+      160, 52, frame_buffer_config.pixel_format, Window::Surface::kIndexed);
   DrawWindow(*main_window->Writer(), "Hellow_window");
   // make_window
 
@@ -342,41 +405,91 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
     Log(kError, "failed to initialize frame buffer: %s at %s:%d\n", err.Name(),
         err.File(), err.Line());
   }
+  if (auto err = screen.InitializeBackBuffer()) {
+    Log(kError, "failed to initialize back buffer: %s at %s:%d\n", err.Name(),
+        err.File(), err.Line());
+  }
+  ::screen = &screen;
   // create_screen
 
+  // init_virtio_gpu
+  // virtio-gpu があれば，変化した矩形だけをホストへ転送して表示する
+  for (int i = 0; i < pci::num_device; ++i) {
+    auto &dev = pci::devices[i];
+    if (pci::ReadVendorId(dev) != virtio::kVendorID ||
+        pci::ReadDeviceId(dev.bus, dev.device, dev.function) !=
+            virtio::Gpu::kDeviceID) {
+      continue;
+    }
+    virtio_gpu = new (virtio_gpu_buf) virtio::Gpu;
+    if (auto err = virtio_gpu->Initialize(dev, screen.BackBuffer())) {
+      Log(kWarn, "failed to initialize virtio-gpu: %s at %s:%d\n", err.Name(),
+          err.File(), err.Line());
+      virtio_gpu = nullptr;
+      break;
+    }
+    screen.SetScanout(virtio_gpu);
+    Log(kInfo, "virtio-gpu: presenting damaged rectangles\n");
+    break;
+  }
+  // init_virtio_gpu
+
+  // init_bochs_display
+  // Bochs dispi 互換の表示装置があれば，VRAM の2ページを切り替えて表示する
+  for (int i = 0; virtio_gpu == nullptr && i < pci::num_device; ++i) {
+    auto &dev = pci::devices[i];
+    if (pci::ReadVendorId(dev) != BochsDisplay::kVendorID ||
+        pci::ReadDeviceId(dev.bus, dev.device, dev.function) !=
+            BochsDisplay::kDeviceID) {
+      continue;
+    }
+    bochs_display = new (bochs_display_buf) BochsDisplay;
+    if (auto err = bochs_display->Initialize(dev, screen_size.x,
+                                             screen_size.y)) {
+      Log(kWarn, "failed to initialize Bochs display: %s at %s:%d\n",
+          err.Name(), err.File(), err.Line());
+      bochs_display = nullptr;
+      break;
+    }
+    SetCacheType(reinterpret_cast<uint64_t>(bochs_display->VRAM()),
+                 bochs_display->PagesBytes(), CacheType::kWriteCombining);
+    screen.SetScanout(bochs_display);
+    Log(kInfo, "Bochs display: page flipping enabled\n");
+    break;
+  }
+  // init_bochs_display
+
   layer_manager = new LayerManager;
   layer_manager->SetWriter(&screen);
 
   auto bglayer_id =
       layer_manager->NewLayer().SetWindow(bgwindow).Move({0, 0}).ID();
-  mouse_layer_id = layer_manager->NewLayer()
-                       .SetWindow(mouse_window)
-                       .Move(mouse_position)
-                       .ID();
+  console->SetLayerID(
+      layer_manager->NewLayer().SetWindow(console_window).Move({0, 0}).ID());
   auto main_window_layer_id =
       layer_manager->NewLayer().SetWindow(main_window).Move({300, 100}).ID();
 
   layer_manager->UpDown(bglayer_id, 0);
-  layer_manager->UpDown(mouse_layer_id, 1);
-  layer_manager->UpDown(main_window_layer_id, 1);
+  layer_manager->UpDown(console->LayerID(), 1);
+  layer_manager->UpDown(main_window_layer_id, 2);
   layer_manager->Draw();
+  layer_manager->SetCursor(mouse_window, mouse_position);
 
   // main_window
   printk("kokomade kita!\n");
 
+  // 以降の再描画はタイマー割り込みに合わせてまとめて行う
+  frame_scheduler = new (frame_scheduler_buf) FrameScheduler{*layer_manager};
+  frame_scheduler->Start();
+
+  // F12 で合成の統計を重ねて表示する
+  stats_overlay = new (stats_overlay_buf)
+      StatsOverlay{*layer_manager, *frame_scheduler, screen};
+
   char str[128];
   unsigned int count = 0;
 
   while (true) {
-
-    ++count;
-    count %= 100000;
-    sprintf(str, "%010u", count);
-    FillRectangle(*main_window->Writer(), {24, 28}, {8 * 10, 16},
-                  {0xc6, 0xc6, 0xc6});
-    WriteString(*main_window->Writer(), {24, 28}, str, {0, 0, 0});
-    layer_manager->Draw();
-
     __asm__("cli");
 
     if (main_queue.Count() == 0) {
@@ -391,6 +504,7 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
     // get_front_message
     switch (msg.type) {
     case Message::kInterruptXHCI:
+      xhci_interrupt_tsc = msg.tsc;
       while (xhc.PrimaryEventRing()->HasFront()) {
         if (auto err = ProcessEvent(xhc)) {
           Log(kError, "Error while ProcessEvent: %s at %s:%d\n", err.Name(),
@@ -398,6 +512,19 @@ KernelMainNewStack(const FrameBufferConfig &frame_buffer_config_ref,
         }
       }
       break;
+    case Message::kInterruptLAPICTimer:
+      ++count;
+      count %= 100000;
+      sprintf(str, "%010u", count);
+      FillRectangle(*main_window->Writer(), {24, 28}, {8 * 10, 16},
+                    {0xc6, 0xc6, 0xc6});
+      WriteString(*main_window->Writer(), {24, 28}, str, {0, 0, 0});
+      layer_manager->Draw(main_window_layer_id);
+      // 前回からコンソールに書かれた文字をまとめて画面に出す
+      console->Flush();
+      stats_overlay->OnTimer();
+      frame_scheduler->OnTimer();
+      break;
     default:
       Log(kError, "Unknown message type: %d\n", msg.type);
       // break;
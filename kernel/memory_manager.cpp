@@ -7,7 +7,15 @@ BitMapMemoryManager::BitMapMemoryManager()
 
 // allocate
 WithError<FrameID> BitMapMemoryManager::Allocate(size_t num_frames) {
-  size_t start_frame_id = range_begin_.ID();
+  return Allocate(num_frames, 1);
+}
+
+WithError<FrameID> BitMapMemoryManager::Allocate(size_t num_frames,
+                                                 size_t align_frames) {
+  auto align_up = [align_frames](size_t id) {
+    return (id + align_frames - 1) / align_frames * align_frames;
+  };
+  size_t start_frame_id = align_up(range_begin_.ID());
   while (true) {
     size_t i = 0;
     for (; i < num_frames; ++i) {
@@ -24,8 +32,8 @@ WithError<FrameID> BitMapMemoryManager::Allocate(size_t num_frames) {
       MarkAllocated(FrameID{start_frame_id}, num_frames);
       return {FrameID{start_frame_id}, MAKE_ERROR(Error::kSuccess)};
     }
-    // 次のフレームから再検索
-    start_frame_id += i + 1;
+    // 次のフレーム以降で境界に揃った位置から再検索
+    start_frame_id = align_up(start_frame_id + i + 1);
   }
 }
 // allocate
@@ -33,7 +41,7 @@ WithError<FrameID> BitMapMemoryManager::Allocate(size_t num_frames) {
 // free
 Error BitMapMemoryManager::Free(FrameID start_frame, size_t num_frames) {
   for (size_t i = 0; i < num_frames; ++i) {
-    SetBit(FrameID{start_frame.ID()}, false);
+    SetBit(FrameID{start_frame.ID() + i}, false);
   }
   return MAKE_ERROR(Error::kSuccess);
 }
@@ -43,7 +51,7 @@ Error BitMapMemoryManager::Free(FrameID start_frame, size_t num_frames) {
 void BitMapMemoryManager::MarkAllocated(FrameID start_frame,
                                         size_t num_frames) {
   for (size_t i = 0; i < num_frames; ++i) {
-    SetBit(FrameID{start_frame.ID() + 1}, true);
+    SetBit(FrameID{start_frame.ID() + i}, true);
   }
 }
 // mark_allocated
@@ -77,6 +85,28 @@ void BitMapMemoryManager::SetBit(FrameID frame, bool allocated) {
 }
 // get_set_bit
 
+// large_buffer
+WithError<uint8_t *> AllocateLargeBuffer(size_t bytes) {
+  if (memory_manager == nullptr) {
+    return {nullptr, MAKE_ERROR(Error::kNoEnoughMemory)};
+  }
+  const auto num_frames = (bytes + kBytesPerFrame - 1) / kBytesPerFrame;
+  const auto align_frames = kLargeBufferAlignment / kBytesPerFrame;
+  const auto start = memory_manager->Allocate(num_frames, align_frames);
+  if (start.error) {
+    return {nullptr, start.error};
+  }
+  return {reinterpret_cast<uint8_t *>(start.value.Frame()),
+          MAKE_ERROR(Error::kSuccess)};
+}
+
+void FreeLargeBuffer(uint8_t *buffer, size_t bytes) {
+  const auto num_frames = (bytes + kBytesPerFrame - 1) / kBytesPerFrame;
+  const FrameID start{reinterpret_cast<uintptr_t>(buffer) / kBytesPerFrame};
+  memory_manager->Free(start, num_frames);
+}
+// large_buffer
+
 // set_program_break
 
 extern "C" caddr_t program_break, program_break_end;
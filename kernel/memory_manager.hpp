@@ -2,6 +2,7 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 
 #include "error.hpp"
@@ -63,6 +64,9 @@ public:
 
   /** @brief 要求されたフレーム数の領域を確保して先頭のフレームIDを返す */
   WithError<FrameID> Allocate(size_t num_frames);
+  /** @brief 先頭のフレームIDが align_frames の倍数になるように
+   * 要求されたフレーム数の領域を確保する */
+  WithError<FrameID> Allocate(size_t num_frames, size_t align_frames);
   Error Free(FrameID start_frame, size_t num_frames);
   void MarkAllocated(FrameID start_frame, size_t num_frames);
 
@@ -88,4 +92,24 @@ private:
 };
 // bitmap_memory_manager
 
+extern BitMapMemoryManager *memory_manager;
+
+// large_buffer
+/** @brief AllocateLargeBuffer が返す領域の先頭の境界（バイト単位）
+ *
+ * 物理メモリは 2MiB ページでアイデンティティマップしているので，
+ * この境界に揃えると領域が使う TLB エントリが最も少なくなる
+ */
+static const auto kLargeBufferAlignment{2_MiB};
+
+/** @brief kLargeBufferAlignment に揃った連続した物理フレームを
+ * bytes バイト分，ヒープを通さずに memory_manager から直接確保する
+ *
+ * 中身は初期化しない。memory_manager が未初期化ならエラーを返す
+ */
+WithError<uint8_t *> AllocateLargeBuffer(size_t bytes);
+/** @brief AllocateLargeBuffer で確保した領域を解放する */
+void FreeLargeBuffer(uint8_t *buffer, size_t bytes);
+// large_buffer
+
 Error InitializeHeap(BitMapMemoryManager &memory_manager);
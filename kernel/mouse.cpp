@@ -1,51 +1,26 @@
 #include "mouse.hpp"
 
 #include "graphics.hpp"
+#include "image.hpp"
+#include "logger.hpp"
 
-namespace {
+// assets/mouse_cursor.ppm を tools/makeimage.py で変換して埋め込んだもの
+extern const uint8_t _binary_assets_mouse_cursor_img_start[];
+extern const uint8_t _binary_assets_mouse_cursor_img_end[];
 
-// clang-format off
-const char mouse_cursor_shape[kMouseCursorHeight][kMouseCursorWidth + 1] = {
-  "@              ",
-  "@@             ",
-  "@.@            ",
-  "@..@           ",
-  "@...@          ",
-  "@....@         ",
-  "@.....@        ",
-  "@......@       ",
-  "@.......@      ",
-  "@........@     ",
-  "@.........@    ",
-  "@..........@   ",
-  "@...........@  ",
-  "@............@ ",
-  "@......@@@@@@@@",
-  "@......@       ",
-  "@....@@.@      ",
-  "@...@ @.@      ",
-  "@..@   @.@     ",
-  "@.@    @.@     ",
-  "@@      @.@    ",
-  "@       @.@    ",
-  "         @.@   ",
-  "         @@@   ",
-};
-// clang-format on
-// #@@range_end(mosue_cursor_shape)
-}; // namespace
+namespace {
+Image mouse_cursor_image;
+} // namespace
 
 void DrawMouseCursor(PixelWriter *pixel_writer, Vector2D<int> position) {
-  for (int dy = 0; dy < kMouseCursorHeight; ++dy) {
-    for (int dx = 0; dx < kMouseCursorWidth; ++dx) {
-      if (mouse_cursor_shape[dy][dx] == '@') {
-        pixel_writer->Write(position + Vector2D<int>{dx, dy}, {0, 0, 0});
-      } else if (mouse_cursor_shape[dy][dx] == '.') {
-        pixel_writer->Write(position + Vector2D<int>{dx, dy}, {255, 255, 255});
-      } else {
-        pixel_writer->Write(position + Vector2D<int>{dx, dy},
-                            kMouseTransparentColor);
-      }
-    }
+  if (auto err = LoadEmbeddedImage(mouse_cursor_image,
+                                   _binary_assets_mouse_cursor_img_start,
+                                   _binary_assets_mouse_cursor_img_end)) {
+    Log(kError, "failed to load the mouse cursor image: %s\n", err.Name());
+    return;
   }
+  // 画像の透明な部分には何も書かれないので，先に透過色で埋めておく
+  pixel_writer->FillRect({position, {kMouseCursorWidth, kMouseCursorHeight}},
+                         kMouseTransparentColor);
+  mouse_cursor_image.DrawTo(*pixel_writer, position);
 }
@@ -1,8 +1,11 @@
 #include "paging.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cpuid.h>
 
 #include "asmfunc.h"
+#include "logger.hpp"
 
 // #@@range_begin(setup_page)
 namespace {
@@ -14,18 +17,140 @@ alignas(kPageSize4K) std::array<uint64_t, 512> pml4_table;
 alignas(kPageSize4K) std::array<uint64_t, 512> pdp_table;
 alignas(kPageSize4K)
     std::array<std::array<uint64_t, 512>, kPageDirectoryCount> page_directory;
+
+/** @brief 2MiB ページを 4KiB ページに分けるときに使うページテーブルの数 */
+const size_t kPageTableCount = 16;
+alignas(kPageSize4K)
+    std::array<std::array<uint64_t, 512>, kPageTableCount> page_tables;
+size_t num_page_tables = 0;
+
+// page_attributes
+const uint64_t kPagePresent = 0x001;
+const uint64_t kPageWritable = 0x002;
+const uint64_t kPageWriteThrough = 0x008; // PWT
+const uint64_t kPageCacheDisable = 0x010; // PCD
+const uint64_t kPageHuge = 0x080;
+const uint64_t kPagePAT4K = 0x080;
+const uint64_t kPagePAT2M = 0x1000;
+/** @brief メモリタイプを選ぶビット（PAT, PCD, PWT）
+ *
+ * PAT ビットの位置は 2MiB ページと 4KiB ページで違う
+ */
+const uint64_t kPageTypeMask =
+    kPagePAT2M | kPageCacheDisable | kPageWriteThrough;
+const uint64_t kPageTypeMask4K =
+    kPagePAT4K | kPageCacheDisable | kPageWriteThrough;
+
+const uint32_t kIA32PAT = 0x277;
+/** @brief PAT の各エントリに書くメモリタイプの値 */
+const uint64_t kPATWriteCombining = 0x01;
+
+bool pat_supported = false;
+// page_attributes
 } // namespace
 
 void SetupIdentityPageTable() {
-  pml4_table[0] = reinterpret_cast<uint64_t>(&pdp_table[0]) | 0x003;
+  const uint64_t table_attr = kPagePresent | kPageWritable;
+  pml4_table[0] = reinterpret_cast<uint64_t>(&pdp_table[0]) | table_attr;
   for (int i_pdpt = 0; i_pdpt < page_directory.size(); ++i_pdpt) {
     pdp_table[i_pdpt] =
-        reinterpret_cast<uint64_t>(&page_directory[i_pdpt]) | 0x003;
+        reinterpret_cast<uint64_t>(&page_directory[i_pdpt]) | table_attr;
     for (int i_pd = 0; i_pd < 512; ++i_pd) {
-      page_directory[i_pdpt][i_pd] =
-          i_pdpt * kPageSize1G + i_pd * kPageSize2M | 0x083;
+      const uint64_t addr = i_pdpt * kPageSize1G + i_pd * kPageSize2M;
+      page_directory[i_pdpt][i_pd] = addr | table_attr | kPageHuge;
+    }
+  }
+
+  SetCR3(reinterpret_cast<uint64_t>(&pml4_table[0]));
+
+  // PWT=1, PCD=0, PAT=0 で選ばれる PA1 を WT から WC に変える。
+  // ファームウェアのページテーブルが PA1 を使っていたかもしれないので，
+  // 自前のページテーブルに切り替えてから，キャッシュを書き戻して書き換え，
+  // TLB に残った古い属性も捨てる
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & (1u << 16))) { // PAT
+    __asm__ volatile("wbinvd" ::: "memory");
+    const uint64_t pat = ReadMSR(kIA32PAT);
+    WriteMSR(kIA32PAT, (pat & ~(0xffull << 8)) | (kPATWriteCombining << 8));
+    SetCR3(reinterpret_cast<uint64_t>(&pml4_table[0]));
+    pat_supported = true;
+  }
+}
+
+// set_memory_type
+namespace {
+/** @brief 2MiB ページの entry を，同じ属性を持つ 4KiB ページの並びに置き換える
+ *
+ * 既に分けてあれば，そのページテーブルを返す。
+ * 使えるページテーブルが残っていなければ nullptr を返す
+ */
+std::array<uint64_t, 512> *SplitPage(uint64_t &entry, uint64_t page) {
+  if ((entry & kPageHuge) == 0) {
+    return reinterpret_cast<std::array<uint64_t, 512> *>(entry & ~0xfffull);
+  }
+  if (num_page_tables == kPageTableCount) {
+    return nullptr;
+  }
+  auto &table = page_tables[num_page_tables++];
+  // PAT ビットを 4KiB ページの位置へ移し，PWT と PCD はそのまま引き継ぐ
+  uint64_t attr = kPagePresent | kPageWritable |
+                  (entry & (kPageCacheDisable | kPageWriteThrough));
+  if (entry & kPagePAT2M) {
+    attr |= kPagePAT4K;
+  }
+  for (int i = 0; i < 512; ++i) {
+    table[i] = (page + i * kPageSize4K) | attr;
+  }
+  entry = reinterpret_cast<uint64_t>(&table[0]) | kPagePresent | kPageWritable;
+  return &table;
+}
+} // namespace
+
+void SetCacheType(uint64_t addr, uint64_t bytes, CacheType type) {
+  uint64_t type_bits = 0;
+  switch (type) {
+  case CacheType::kWriteBack:
+    type_bits = 0; // PA0: WB
+    break;
+  case CacheType::kWriteCombining:
+    if (!pat_supported) {
+      return;
+    }
+    type_bits = kPageWriteThrough; // PA1: WC
+    break;
+  case CacheType::kUncached:
+    type_bits = kPageCacheDisable | kPageWriteThrough; // PA3: UC
+    break;
+  }
+
+  const uint64_t end = addr + bytes;
+  const uint64_t mapped_end = kPageDirectoryCount * kPageSize1G;
+  for (uint64_t page = addr & ~(kPageSize2M - 1);
+       page < end && page < mapped_end; page += kPageSize2M) {
+    auto &entry = page_directory[page / kPageSize1G]
+                                [page % kPageSize1G / kPageSize2M];
+    const uint64_t begin = std::max(addr, page);
+    const uint64_t last = std::min(end, page + kPageSize2M);
+    if ((entry & kPageHuge) && begin == page && last == page + kPageSize2M) {
+      entry = (entry & ~kPageTypeMask) | type_bits;
+      continue;
+    }
+
+    // 範囲が 2MiB ページの一部だけなら，4KiB ページに分けて該当部分だけ変える
+    auto table = SplitPage(entry, page);
+    if (table == nullptr) {
+      Log(kError, "no page table left to set cache type of %lx-%lx\n", begin,
+          last);
+      continue;
+    }
+    for (uint64_t p = begin & ~(kPageSize4K - 1); p < last; p += kPageSize4K) {
+      auto &pte = (*table)[(p - page) / kPageSize4K];
+      pte = (pte & ~kPageTypeMask4K) | type_bits;
     }
   }
 
+  // 古い属性が残らないように，キャッシュを書き戻してから TLB を捨てる
+  __asm__ volatile("wbinvd" ::: "memory");
   SetCR3(reinterpret_cast<uint64_t>(&pml4_table[0]));
 }
+// set_memory_type
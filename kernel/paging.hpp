@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
 // 1つのページディレクトリには512個の2MiBページが設定できることから，
 // kPageDirectoryCount * 1GiB の仮想アドレスがマッピングされることになる
@@ -8,5 +9,26 @@ const size_t kPageDirectoryCount = 64;
 
 /** @brief 仮想アドレスと物理アドレスが一致するようにページテーブルを設定する
  * 最終的にはCR3レジスタが正しく設定されたページテーブルを指すようになる
+ *
+ * CPU が PAT に対応していれば，PAT の PA1 を書き込み結合（WC）に設定する
  * */
 void SetupIdentityPageTable();
+
+/** @brief ページに設定するメモリタイプ（キャッシュの方式） */
+enum class CacheType {
+  /** @brief ライトバック。通常のメモリ */
+  kWriteBack,
+  /** @brief 書き込み結合。フレームバッファへの連続した書き込みを速くする */
+  kWriteCombining,
+  /** @brief キャッシュしない。MMIO 用 */
+  kUncached,
+};
+
+/** @brief 物理アドレス addr から bytes バイトの範囲のメモリタイプを設定する
+ *
+ * 範囲が 2MiB ページを丸ごと覆わない部分は 4KiB ページに分け，
+ * 範囲を含む 4KiB 境界まで広げて適用する。分けるためのページテーブルが
+ * 足りなければ，その 2MiB ページは変えずにエラーを記録する。
+ * PAT に対応していない CPU では kWriteCombining は何もしない
+ * */
+void SetCacheType(uint64_t addr, uint64_t bytes, CacheType type);
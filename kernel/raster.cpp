@@ -0,0 +1,370 @@
+#include "raster.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+// utils
+namespace {
+/** @brief 描画先の範囲に切り詰めてからスパンを塗る */
+class SpanFiller {
+public:
+  SpanFiller(PixelWriter &writer, const PixelColor &c)
+      : writer_{writer}, color_{c}, width_{writer.Width()},
+        height_{writer.Height()} {}
+
+  int Height() const { return height_; }
+
+  /** @brief 行 y の x_begin から x_last まで（両端を含む）を塗る */
+  void operator()(long long y, long long x_begin, long long x_last) {
+    if (y < 0 || y >= height_) {
+      return;
+    }
+    x_begin = std::max(x_begin, 0ll);
+    x_last = std::min(x_last, static_cast<long long>(width_) - 1);
+    if (x_begin > x_last) {
+      return;
+    }
+    writer_.FillSpan({static_cast<int>(x_begin), static_cast<int>(y)},
+                     static_cast<int>(x_last - x_begin + 1), color_);
+  }
+
+private:
+  PixelWriter &writer_;
+  const PixelColor color_;
+  const int width_, height_;
+};
+
+/** @brief a / b を正の無限大の方向へ丸める。b は正でなければならない */
+long long CeilDiv(long long a, long long b) {
+  return a >= 0 ? (a + b - 1) / b : -(-a / b);
+}
+
+/** @brief floor(sqrt(x)) を返す */
+long long ISqrt(long long x) {
+  if (x <= 0) {
+    return 0;
+  }
+  long long r = x, next = (r + 1) / 2;
+  while (next < r) {
+    r = next;
+    next = (r + x / r) / 2;
+  }
+  return r;
+}
+
+/** @brief 角の丸い矩形を行ごとに処理するための情報 */
+class RoundedRows {
+public:
+  /** @brief radius は角の円が重ならないように短い辺の半分までに切り詰める */
+  RoundedRows(Vector2D<int> size, int radius) : size_{size} {
+    radius_ = std::max(0, std::min(radius, (std::min(size.x, size.y) - 1) / 2));
+  }
+
+  int Radius() const { return radius_; }
+
+  /** @brief 行 y の塗る範囲が，角の円の中心から外へ何ピクセル伸びるか
+   *
+   * 行 y が矩形の外なら -1 を返す。ピクセルの中心が半径 + 0.5 の円の内側に
+   * あるかどうかで判定する
+   */
+  int Extent(int y) const {
+    if (y < 0 || y >= size_.y) {
+      return -1;
+    }
+    int dy = 0;
+    if (y < radius_) {
+      dy = radius_ - y;
+    } else if (y > size_.y - 1 - radius_) {
+      dy = y - (size_.y - 1 - radius_);
+    }
+    const long long r = radius_, d = dy;
+    return static_cast<int>(ISqrt(r * r + r - d * d));
+  }
+
+private:
+  Vector2D<int> size_;
+  int radius_;
+};
+
+/** @brief 0 度から 90 度までの sin を 1 << 14 倍して整数にした表 */
+const int kSinTable[91] = {
+    0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563, 2845, 3126, 3406,
+    3686, 3964, 4240, 4516, 4790, 5063, 5334, 5604, 5872, 6138, 6402, 6664,
+    6924, 7182, 7438, 7692, 7943, 8192, 8438, 8682, 8923, 9162, 9397, 9630,
+    9860, 10087, 10311, 10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982,
+    12176, 12365, 12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894,
+    14044, 14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083, 16135,
+    16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382, 16384,
+};
+
+/** @brief x 軸の正の向きから画面上で時計回りに angle 度回した向きの
+ * 単位ベクトルを 1 << 14 倍して返す */
+Vector2D<long long> Direction(int angle) {
+  const int a = (angle % 360 + 360) % 360;
+  const int r = a % 90;
+  Vector2D<long long> v{kSinTable[90 - r], kSinTable[r]};
+  // 90 度ずつ時計回りに回す。y 軸は下向きなので (x, y) は (-y, x) になる
+  for (int q = 0; q < a / 90; ++q) {
+    v = {-v.y, v.x};
+  }
+  return v;
+}
+
+/** @brief 時計回りに start_angle から end_angle までの角度の範囲
+ *
+ * ピクセルの中心の向きが範囲に入るかを，範囲の両端の向きとの
+ * 外積の符号で判定する
+ */
+class ArcRange {
+public:
+  ArcRange(int start_angle, int end_angle)
+      : start_{Direction(start_angle)}, end_{Direction(end_angle)} {
+    const long long sweep = static_cast<long long>(end_angle) - start_angle;
+    if (sweep >= 360) {
+      sweep_ = 360;
+    } else {
+      sweep_ = static_cast<int>((sweep % 360 + 360) % 360);
+    }
+  }
+
+  bool IsEmpty() const { return sweep_ == 0; }
+
+  /** @brief 中心から (x, y) の向きが範囲に入っていれば true */
+  bool Contains(long long x, long long y) const {
+    if (sweep_ == 360 || (x == 0 && y == 0)) {
+      return sweep_ > 0;
+    }
+    const Vector2D<long long> p{x, y};
+    // 180 度までなら [start, start + 180) から [end, end + 180) を除いた範囲。
+    // 超えるなら [start, start + 180) と [end - 180, end) を合わせた範囲
+    if (sweep_ <= 180) {
+      return InHalfTurn(start_, p) && !InHalfTurn(end_, p);
+    }
+    return InHalfTurn(start_, p) || !InHalfTurn(end_, p);
+  }
+
+private:
+  Vector2D<long long> start_, end_;
+  int sweep_;
+
+  /** @brief p の向きが a から時計回りに [0, 180) 度の範囲にあれば true */
+  static bool InHalfTurn(Vector2D<long long> a, Vector2D<long long> p) {
+    const long long cross = a.x * p.y - a.y * p.x;
+    return cross > 0 || (cross == 0 && a.x * p.x + a.y * p.y > 0);
+  }
+};
+
+/** @brief 描画先に見えている行だけを [begin, end) として返す */
+Vector2D<int> VisibleRows(int top, int height, int screen_height) {
+  return {std::max(0, -top), std::min(height, screen_height - top)};
+}
+} // namespace
+// utils
+
+// line
+void DrawLine(PixelWriter &writer, Vector2D<int> p0, Vector2D<int> p1,
+              const PixelColor &c) {
+  SpanFiller fill{writer, c};
+  long long dx = static_cast<long long>(p1.x) - p0.x;
+  long long dy = static_cast<long long>(p1.y) - p0.y;
+  if (std::llabs(dx) >= std::llabs(dy)) {
+    // 横に長い線分。行 k に入るのは主軸方向に進んだ量 t が
+    // (2k - 1)n / 2d <= t < (2k + 1)n / 2d を満たす点
+    if (dx < 0) {
+      std::swap(p0, p1);
+      dx = -dx;
+      dy = -dy;
+    }
+    if (dy == 0) {
+      fill(p0.y, p0.x, p1.x);
+      return;
+    }
+    const long long n = dx, d = std::llabs(dy), sy = dy > 0 ? 1 : -1;
+    // 見えている行だけを，p0 から数えた行数 k の範囲として求める
+    const long long k_begin =
+        std::max(0ll, sy > 0 ? -p0.y : p0.y - (fill.Height() - 1ll));
+    const long long k_last =
+        std::min(d, sy > 0 ? fill.Height() - 1ll - p0.y : p0.y);
+    for (long long k = k_begin; k <= k_last; ++k) {
+      const auto t0 = std::max(0ll, CeilDiv((2 * k - 1) * n, 2 * d));
+      const auto t1 = std::min(n, CeilDiv((2 * k + 1) * n, 2 * d) - 1);
+      fill(p0.y + sy * k, p0.x + t0, p0.x + t1);
+    }
+    return;
+  }
+
+  // 縦に長い線分。行ごとに1ピクセルを塗る
+  if (dy < 0) {
+    std::swap(p0, p1);
+    dx = -dx;
+    dy = -dy;
+  }
+  const long long n = dy, d = std::llabs(dx), sx = dx > 0 ? 1 : -1;
+  const long long t_begin = std::max(0ll, -static_cast<long long>(p0.y));
+  const long long t_last = std::min(n, fill.Height() - 1ll - p0.y);
+  for (long long t = t_begin; t <= t_last; ++t) {
+    const long long x = p0.x + sx * ((2 * t * d + n) / (2 * n));
+    fill(p0.y + t, x, x);
+  }
+}
+// line
+
+// rounded_rectangle
+void DrawRoundedRectangle(PixelWriter &writer, const Vector2D<int> &pos,
+                          const Vector2D<int> &size, int radius,
+                          const PixelColor &c) {
+  if (size.x <= 0 || size.y <= 0) {
+    return;
+  }
+  SpanFiller fill{writer, c};
+  const RoundedRows shape{size, radius};
+  const int left = pos.x + shape.Radius();
+  const int right = pos.x + size.x - 1 - shape.Radius();
+  const auto rows = VisibleRows(pos.y, size.y, fill.Height());
+  for (int y = rows.x; y < rows.y; ++y) {
+    const int extent = shape.Extent(y);
+    // 矩形の外側に隣接する行の方が狭い。その行からはみ出す部分が枠になる
+    const int outer = shape.Extent(y < size.y / 2 ? y - 1 : y + 1);
+    if (outer < 0) {
+      fill(pos.y + y, left - extent, right + extent);
+      continue;
+    }
+    const int inner = std::min(outer + 1, extent);
+    if (left - inner + 1 >= right + inner) {
+      fill(pos.y + y, left - extent, right + extent);
+      continue;
+    }
+    fill(pos.y + y, left - extent, left - inner);
+    fill(pos.y + y, right + inner, right + extent);
+  }
+}
+
+void FillRoundedRectangle(PixelWriter &writer, const Vector2D<int> &pos,
+                          const Vector2D<int> &size, int radius,
+                          const PixelColor &c) {
+  if (size.x <= 0 || size.y <= 0) {
+    return;
+  }
+  SpanFiller fill{writer, c};
+  const RoundedRows shape{size, radius};
+  const int left = pos.x + shape.Radius();
+  const int right = pos.x + size.x - 1 - shape.Radius();
+  const auto rows = VisibleRows(pos.y, size.y, fill.Height());
+  for (int y = rows.x; y < rows.y; ++y) {
+    const int extent = shape.Extent(y);
+    fill(pos.y + y, left - extent, right + extent);
+  }
+}
+// rounded_rectangle
+
+// circle
+void DrawCircle(PixelWriter &writer, Vector2D<int> center, int radius,
+                const PixelColor &c) {
+  if (radius < 0) {
+    return;
+  }
+  DrawRoundedRectangle(writer, center - Vector2D<int>{radius, radius},
+                       {2 * radius + 1, 2 * radius + 1}, radius, c);
+}
+
+void DrawArc(PixelWriter &writer, Vector2D<int> center, int radius,
+             int start_angle, int end_angle, const PixelColor &c) {
+  const ArcRange range{start_angle, end_angle};
+  if (radius < 0 || range.IsEmpty()) {
+    return;
+  }
+  SpanFiller fill{writer, c};
+  // DrawCircle と同じ円周を行ごとに求め，範囲に入るピクセルの並びだけを塗る
+  auto fill_masked = [&](int y, int x_begin, int x_last) {
+    int x = x_begin;
+    while (x <= x_last) {
+      if (!range.Contains(x, y)) {
+        ++x;
+        continue;
+      }
+      const int begin = x;
+      while (x <= x_last && range.Contains(x, y)) {
+        ++x;
+      }
+      fill(static_cast<long long>(center.y) + y,
+           static_cast<long long>(center.x) + begin,
+           static_cast<long long>(center.x) + x - 1);
+    }
+  };
+  const int size = 2 * radius + 1;
+  const RoundedRows shape{{size, size}, radius};
+  const auto rows = VisibleRows(center.y - radius, size, fill.Height());
+  for (int y = rows.x; y < rows.y; ++y) {
+    const int extent = shape.Extent(y);
+    const int outer = shape.Extent(y < radius ? y - 1 : y + 1);
+    const int inner = outer < 0 ? 0 : std::min(outer + 1, extent);
+    if (inner == 0) {
+      fill_masked(y - radius, -extent, extent);
+      continue;
+    }
+    fill_masked(y - radius, -extent, -inner);
+    fill_masked(y - radius, inner, extent);
+  }
+}
+
+void FillCircle(PixelWriter &writer, Vector2D<int> center, int radius,
+                const PixelColor &c) {
+  if (radius < 0) {
+    return;
+  }
+  FillRoundedRectangle(writer, center - Vector2D<int>{radius, radius},
+                       {2 * radius + 1, 2 * radius + 1}, radius, c);
+}
+// circle
+
+// polygon
+void DrawPolygon(PixelWriter &writer, const Vector2D<int> *points, int count,
+                 const PixelColor &c) {
+  for (int i = 0; i < count; ++i) {
+    DrawLine(writer, points[i], points[(i + 1) % count], c);
+  }
+}
+
+void FillPolygon(PixelWriter &writer, const Vector2D<int> *points, int count,
+                 const PixelColor &c) {
+  if (count < 3) {
+    return;
+  }
+  SpanFiller fill{writer, c};
+  int top = points[0].y, bottom = points[0].y;
+  for (int i = 1; i < count; ++i) {
+    top = std::min(top, points[i].y);
+    bottom = std::max(bottom, points[i].y);
+  }
+  top = std::max(top, 0);
+  bottom = std::min(bottom, fill.Height());
+
+  std::vector<long long> crossings;
+  crossings.reserve(count);
+  for (int y = top; y < bottom; ++y) {
+    // 行 y のピクセルの中心 y + 0.5 を通る水平線と各辺の交点を求め，
+    // その交点より右に中心があるピクセルの x を記録する
+    crossings.clear();
+    for (int i = 0; i < count; ++i) {
+      auto a = points[i], b = points[(i + 1) % count];
+      if (a.y > b.y) {
+        std::swap(a, b);
+      }
+      if (2 * y + 1 < 2 * a.y || 2 * y + 1 >= 2 * b.y) {
+        continue;
+      }
+      // 交点の x は a.x + (2y + 1 - 2a.y)(b.x - a.x) / 2(b.y - a.y)
+      const long long d = b.y - a.y;
+      const long long num = (2ll * a.x - 1) * d +
+                            (2ll * y + 1 - 2ll * a.y) * (b.x - a.x);
+      crossings.push_back(CeilDiv(num, 2 * d));
+    }
+    std::sort(crossings.begin(), crossings.end());
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+      fill(y, crossings[i], crossings[i + 1] - 1);
+    }
+  }
+}
+// polygon
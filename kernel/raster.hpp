@@ -0,0 +1,59 @@
+/**
+ * @file raster.hpp
+ *
+ * 線分，円，多角形，角の丸い矩形を水平なスパンに分解して描く。
+ * 描画先からはみ出す行やスパンは PixelWriter を呼ぶ前に切り捨て，
+ * 各スパンは PixelWriter::FillSpan でまとめて塗る。
+ */
+
+#pragma once
+
+#include "graphics.hpp"
+
+/** @brief p0 から p1 までの線分を描く。両端の点も描く
+ *
+ * 画素の選び方は Bresenham のアルゴリズムと同じで，
+ * 横に長い線分は行ごとに1本のスパンとして塗る
+ */
+void DrawLine(PixelWriter &writer, Vector2D<int> p0, Vector2D<int> p1,
+              const PixelColor &c);
+
+/** @brief center を中心とする半径 radius の円周を描く */
+void DrawCircle(PixelWriter &writer, Vector2D<int> center, int radius,
+                const PixelColor &c);
+/** @brief center を中心とする半径 radius の円弧を描く
+ *
+ * 角度は度数で，x 軸の正の向きから画面上で時計回りに測る。
+ * DrawCircle と同じ円周のピクセルのうち，中心から見たピクセルの中心の向きが
+ * start_angle から時計回りに end_angle の手前までにあるものを描く。
+ * 差が 360 以上なら円周全体を描き，両者が同じなら何も描かない
+ */
+void DrawArc(PixelWriter &writer, Vector2D<int> center, int radius,
+             int start_angle, int end_angle, const PixelColor &c);
+/** @brief center を中心とする半径 radius の円を塗りつぶす */
+void FillCircle(PixelWriter &writer, Vector2D<int> center, int radius,
+                const PixelColor &c);
+
+/** @brief points の count 個の点を順に結んだ閉じた折れ線を描く */
+void DrawPolygon(PixelWriter &writer, const Vector2D<int> *points, int count,
+                 const PixelColor &c);
+/** @brief points の count 個の点を頂点とする多角形を塗りつぶす
+ *
+ * 辺が交差する場合は偶奇規則で内側を決める。
+ * ピクセルの中心が多角形の内側にあるピクセルを塗るので，
+ * 辺を共有する多角形を並べても境界のピクセルを二重に塗らない
+ */
+void FillPolygon(PixelWriter &writer, const Vector2D<int> *points, int count,
+                 const PixelColor &c);
+
+/** @brief 角を半径 radius で丸めた矩形の枠を描く
+ *
+ * radius は短い辺の半分までに切り詰める。radius が 0 なら DrawRectangle と同じ
+ */
+void DrawRoundedRectangle(PixelWriter &writer, const Vector2D<int> &pos,
+                          const Vector2D<int> &size, int radius,
+                          const PixelColor &c);
+/** @brief 角を半径 radius で丸めた矩形を塗りつぶす */
+void FillRoundedRectangle(PixelWriter &writer, const Vector2D<int> &pos,
+                          const Vector2D<int> &size, int radius,
+                          const PixelColor &c);
@@ -0,0 +1,33 @@
+/**
+ * @file scanout.hpp
+ *
+ * 合成済みの画面を表示装置へ出す方法を表す Scanout クラスを提供する。
+ */
+
+#pragma once
+
+#include "graphics.hpp"
+
+class FrameBuffer;
+
+/** @brief FrameBuffer::Present の転送先となる表示装置
+ *
+ * 既定では FrameBuffer は自身が指す VRAM へ直接書き込む。
+ * ページフリップや転送命令が必要な装置はこのクラスを実装し，
+ * FrameBuffer::SetScanout で登録する
+ */
+class Scanout {
+public:
+  virtual ~Scanout() = default;
+  /** @brief src の area の範囲を画面に反映し，書き込んだピクセル数を返す
+   *
+   * area は画面の範囲に切り詰めてある
+   */
+  virtual unsigned long Present(const FrameBuffer &src,
+                                const Rectangle<int> &area) = 0;
+  /** @brief 表示装置が使えなくなった場合に true を返す
+   *
+   * true になると FrameBuffer はこの Scanout を外し，VRAM へ直接書き込む
+   */
+  virtual bool Failed() const { return false; }
+};
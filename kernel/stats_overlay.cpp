@@ -0,0 +1,141 @@
+#include "stats_overlay.hpp"
+
+#include <cstdio>
+#include <limits>
+
+#include "font.hpp"
+#include "graphics.hpp"
+#include "raster.hpp"
+
+// overlay_style
+namespace {
+const PixelColor kTransparentColor{255, 0, 255};
+const PixelColor kBackgroundColor{0x20, 0x20, 0x28};
+const PixelColor kTextColor{0xe0, 0xe0, 0xe0};
+/** @brief レイヤ全体の不透明度。背後のウィンドウが透けて見える */
+const uint8_t kAlpha = 0xd0;
+const int kPadding = 6;
+const int kCornerRadius = 6;
+/** @brief 画面の端からの距離 */
+const int kMargin = 8;
+
+/** @brief a - b を，ticks 周期の間の増分から1秒あたりの値に直す */
+unsigned long PerSecond(unsigned long a, unsigned long b, unsigned long ticks,
+                        unsigned int frame_rate) {
+  return ticks == 0 ? 0 : (a - b) * frame_rate / ticks;
+}
+} // namespace
+// overlay_style
+
+StatsOverlay *stats_overlay;
+
+// overlay_ctor
+StatsOverlay::StatsOverlay(LayerManager &layer_manager,
+                           const FrameScheduler &scheduler,
+                           const FrameBuffer &screen)
+    : layer_manager_{layer_manager}, scheduler_{scheduler}, screen_{screen} {
+  const Vector2D<int> size{8 * kColumns + 2 * kPadding,
+                           16 * kRows + 2 * kPadding};
+  window_ = std::make_shared<Window>(size.x, size.y,
+                                     screen.Config().pixel_format,
+                                     Window::Surface::kIndexed);
+  window_->SetTransparentColor(kTransparentColor);
+  auto &writer = *window_->Writer();
+  FillRectangle(writer, {0, 0}, size, kTransparentColor);
+  FillRoundedRectangle(writer, {0, 0}, size, kCornerRadius, kBackgroundColor);
+
+  const Vector2D<int> pos{
+      static_cast<int>(screen.Config().horizontal_resolution) - size.x -
+          kMargin,
+      kMargin};
+  layer_id_ = layer_manager_.NewLayer()
+                  .SetWindow(window_)
+                  .SetAlpha(kAlpha)
+                  .Move(pos)
+                  .ID();
+  last_sample_ = TakeSample();
+}
+// overlay_ctor
+
+// overlay_toggle
+void StatsOverlay::Toggle() {
+  visible_ = !visible_;
+  if (!visible_) {
+    layer_manager_.Hide(layer_id_);
+    return;
+  }
+  Redraw();
+  layer_manager_.UpDown(layer_id_, std::numeric_limits<int>::max());
+}
+
+bool StatsOverlay::IsVisible() const { return visible_; }
+// overlay_toggle
+
+// overlay_on_timer
+void StatsOverlay::OnTimer() {
+  // FrameScheduler::OnTimer の前に呼ばれるので，今回の周期も数えておく
+  const auto ticks = scheduler_.Stats().ticks + 1 - last_sample_.ticks;
+  if (ticks < scheduler_.FrameRate()) {
+    return;
+  }
+  if (!visible_) {
+    // 表示したときに古い標本との差を出さないよう，標本だけは取り直す
+    last_sample_ = TakeSample();
+    return;
+  }
+  Redraw();
+  layer_manager_.Draw(layer_id_);
+}
+// overlay_on_timer
+
+// overlay_redraw
+StatsOverlay::Sample StatsOverlay::TakeSample() const {
+  const auto &stats = scheduler_.Stats();
+  return {stats.ticks,
+          stats.frames,
+          stats.total_compose_ns,
+          screen_.PresentedPixels(),
+          layer_manager_.DrawnLayers(),
+          layer_manager_.SkippedLayers()};
+}
+
+void StatsOverlay::Redraw() {
+  const auto sample = TakeSample();
+  const auto &last = last_sample_;
+  const auto &stats = scheduler_.Stats();
+  const auto ticks = sample.ticks - last.ticks;
+  const auto frame_rate = scheduler_.FrameRate();
+  const auto frames = sample.frames - last.frames;
+  const auto compose_us =
+      frames == 0 ? 0 : (sample.compose_ns - last.compose_ns) / frames / 1000;
+
+  char lines[kRows][kColumns + 1];
+  snprintf(lines[0], sizeof(lines[0]), "fps     %5lu / %u",
+           PerSecond(sample.frames, last.frames, ticks, frame_rate),
+           frame_rate);
+  snprintf(lines[1], sizeof(lines[1]), "compose %5lu us (max %lu)",
+           static_cast<unsigned long>(compose_us),
+           static_cast<unsigned long>(stats.max_compose_ns / 1000));
+  snprintf(lines[2], sizeof(lines[2]), "vram    %9lu px/s",
+           PerSecond(sample.presented_pixels, last.presented_pixels, ticks,
+                     frame_rate));
+  snprintf(lines[3], sizeof(lines[3]), "layers  %5lu drawn %5lu skip",
+           PerSecond(sample.drawn_layers, last.drawn_layers, ticks,
+                     frame_rate),
+           PerSecond(sample.skipped_layers, last.skipped_layers, ticks,
+                     frame_rate));
+  snprintf(lines[4], sizeof(lines[4]), "input   %5lu us (max %lu)",
+           static_cast<unsigned long>(stats.last_input_latency_ns / 1000),
+           static_cast<unsigned long>(stats.max_input_latency_ns / 1000));
+
+  // 角の丸みにかからない文字の範囲だけを塗り直す
+  auto &writer = *window_->Writer();
+  FillRectangle(writer, {kPadding, kPadding}, {8 * kColumns, 16 * kRows},
+                kBackgroundColor);
+  for (int row = 0; row < kRows; ++row) {
+    WriteString(writer, {kPadding, kPadding + 16 * row}, lines[row],
+                kTextColor);
+  }
+  last_sample_ = sample;
+}
+// overlay_redraw
@@ -0,0 +1,63 @@
+/**
+ * @file stats_overlay.hpp
+ *
+ * 合成の統計（フレームレート，合成時間，VRAM へ書き込んだピクセル数，
+ * 描いたレイヤと省いたレイヤの数，入力から反映までの時間）を
+ * 画面の右上に半透明のレイヤとして重ねて表示する。
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "frame_buffer.hpp"
+#include "frame_scheduler.hpp"
+#include "layer.hpp"
+#include "window.hpp"
+
+class StatsOverlay {
+public:
+  /** @brief 表示を切り替えるキー（HID の Usage ID。F12） */
+  static const uint8_t kToggleKey = 0x45;
+  static const int kColumns = 32, kRows = 5;
+
+  /** @brief オーバーレイのウィンドウとレイヤを作る。最初は表示しない
+   *
+   * @param screen 統計を取る画面。PresentedPixels と大きさを使う
+   */
+  StatsOverlay(LayerManager &layer_manager, const FrameScheduler &scheduler,
+               const FrameBuffer &screen);
+
+  /** @brief 表示と非表示を切り替える。表示するときは最前面に置く */
+  void Toggle();
+  bool IsVisible() const;
+  /** @brief タイマー割り込みごとに FrameScheduler::OnTimer の前に呼び出す
+   *
+   * 表示中なら1秒ごとに統計を描き直し，オーバーレイの範囲だけを
+   * 再描画範囲として記録する
+   */
+  void OnTimer();
+
+private:
+  /** @brief 各計数のある時点の値 */
+  struct Sample {
+    unsigned long ticks, frames;
+    uint64_t compose_ns;
+    unsigned long presented_pixels, drawn_layers, skipped_layers;
+  };
+
+  Sample TakeSample() const;
+  /** @brief 前回の標本からの増分を1秒あたりに直して描き，次の標本を取る */
+  void Redraw();
+
+  LayerManager &layer_manager_;
+  const FrameScheduler &scheduler_;
+  const FrameBuffer &screen_;
+  std::shared_ptr<Window> window_;
+  unsigned int layer_id_;
+  bool visible_{false};
+  Sample last_sample_{};
+};
+
+extern StatsOverlay *stats_overlay;
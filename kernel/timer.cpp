@@ -1,20 +1,81 @@
 #include "timer.hpp"
 
+#include "asmfunc.h"
+#include "interrupt.hpp"
+
 namespace {
 const uint32_t kCountMax = 0xffffffff;
 volatile uint32_t &lvt_timer = *reinterpret_cast<uint32_t *>(0xfee00320);
 volatile uint32_t &initial_count = *reinterpret_cast<uint32_t *>(0xfee00380);
 volatile uint32_t &current_count = *reinterpret_cast<uint32_t *>(0xfee00390);
 volatile uint32_t &devide_config = *reinterpret_cast<uint32_t *>(0xfee003e0);
+
+uint64_t lapic_timer_freq = 0;
+uint64_t tsc_freq = 0;
+
+// pit_wait
+const uint32_t kPITFrequency = 1193182;
+const uint32_t kCalibrationMilliseconds = 10;
+
+/** @brief PIT のチャンネル 2 を使って ms ミリ秒待つ
+ *
+ * チャンネル 2 はスピーカー用で割り込みを起こさないので，
+ * カウントが 0 になったこと（ポート 0x61 のビット 5）をポーリングする
+ */
+void WaitPIT(uint32_t ms) {
+  // ゲートを開き，スピーカーへの出力は止める
+  IoOut8(0x61, (IoIn8(0x61) & ~0x02u) | 0x01u);
+  IoOut8(0x43, 0b10110000); // チャンネル 2, 下位・上位の順, モード 0
+  const uint32_t count = kPITFrequency * ms / 1000;
+  IoOut8(0x42, count & 0xffu);
+  IoOut8(0x42, count >> 8);
+  while ((IoIn8(0x61) & 0x20u) == 0) {
+  }
+}
+// pit_wait
 } // namespace
 
+// initialize_lapic_timer
 void InitializeLAPICTimer() {
-  devide_config = 0b1011;         // 分周比１
-  lvt_timer = (0b001 << 16) | 32; // masked,. one-shot
+  devide_config = 0b1011;                                   // 分周比１
+  lvt_timer = (0b001 << 16) | InterruptVector::kLAPICTimer; // masked, one-shot
+
+  initial_count = kCountMax;
+  const auto tsc_start = ReadTSC();
+  WaitPIT(kCalibrationMilliseconds);
+  const auto lapic_elapsed = kCountMax - current_count;
+  const auto tsc_elapsed = ReadTSC() - tsc_start;
+  initial_count = 0;
+
+  lapic_timer_freq =
+      static_cast<uint64_t>(lapic_elapsed) * 1000 / kCalibrationMilliseconds;
+  tsc_freq = tsc_elapsed * 1000 / kCalibrationMilliseconds;
+}
+// initialize_lapic_timer
+
+void StartLAPICTimerInterrupt(unsigned int frequency) {
+  if (frequency == 0) {
+    return;
+  }
+  initial_count = 0;
+  lvt_timer = (0b010 << 16) | InterruptVector::kLAPICTimer; // periodic
+  initial_count = lapic_timer_freq / frequency;
 }
 
-void StartLAPICTimer() { initial_count = kCountMax; }
+void StopLAPICTimer() {
+  initial_count = 0;
+  lvt_timer = (0b001 << 16) | InterruptVector::kLAPICTimer; // masked, one-shot
+}
+
+uint64_t LAPICTimerFrequency() { return lapic_timer_freq; }
 
-uint32_t LAPICTimerElapsed() { return kCountMax - current_count; }
+uint64_t TSCFrequency() { return tsc_freq; }
 
-void StopLAPICTimer() { initial_count = 0; }
+uint64_t TSCToNanoseconds(uint64_t tsc_count) {
+  if (tsc_freq == 0) {
+    return 0;
+  }
+  // tsc_count * 10^9 はすぐに 64 ビットを超えるので秒の部分を分けて計算する
+  return tsc_count / tsc_freq * 1000000000 +
+         tsc_count % tsc_freq * 1000000000 / tsc_freq;
+}
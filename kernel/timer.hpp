@@ -1,7 +1,18 @@
 #pragma once
 #include <cstdint>
 
+/** @brief LAPIC タイマーを止めた状態で初期化し，PIT を基準にして
+ * LAPIC タイマーと TSC の1秒あたりのカウント数を測る */
 void InitializeLAPICTimer();
-void StartLAPICTimer();
-uint32_t LAPICTimerElapsed();
+/** @brief LAPIC タイマーを周期モードで動かし，毎秒 frequency 回
+ * InterruptVector::kLAPICTimer の割り込みを起こす。
+ * frequency が 0 なら何もしない */
+void StartLAPICTimerInterrupt(unsigned int frequency);
 void StopLAPICTimer();
+
+/** @brief LAPIC タイマーの1秒あたりのカウント数 */
+uint64_t LAPICTimerFrequency();
+/** @brief TSC（ReadTSC の値）の1秒あたりのカウント数 */
+uint64_t TSCFrequency();
+/** @brief TSC のカウント数をナノ秒に換算する。周波数が未測定なら 0 を返す */
+uint64_t TSCToNanoseconds(uint64_t tsc_count);
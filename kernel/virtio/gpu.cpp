@@ -0,0 +1,214 @@
+#include "virtio/gpu.hpp"
+
+#include "logger.hpp"
+
+// gpu_commands
+namespace {
+using namespace virtio;
+
+const uint32_t kCmdResourceCreate2D = 0x0101;
+const uint32_t kCmdSetScanout = 0x0103;
+const uint32_t kCmdResourceFlush = 0x0104;
+const uint32_t kCmdTransferToHost2D = 0x0105;
+const uint32_t kCmdResourceAttachBacking = 0x0106;
+const uint32_t kRespOKNoData = 0x1100;
+
+/** @brief リソースのピクセル形式。名前はメモリ上のバイトの並び */
+const uint32_t kFormatB8G8R8X8 = 2;
+const uint32_t kFormatR8G8B8X8 = 134;
+
+/** @brief コントロールキューの番号 */
+const uint16_t kControlQueue = 0;
+/** @brief このドライバが作るリソースと使うスキャンアウトの番号 */
+const uint32_t kResourceID = 1;
+const uint32_t kScanoutID = 0;
+
+const int kBytesPerPixel = 4;
+
+struct ResourceCreate2D {
+  GpuCtrlHeader header;
+  uint32_t resource_id;
+  uint32_t format;
+  uint32_t width, height;
+} __attribute__((packed));
+
+struct MemEntry {
+  uint64_t addr;
+  uint32_t length;
+  uint32_t padding;
+} __attribute__((packed));
+
+/** @brief 裏付けメモリが1つだけの RESOURCE_ATTACH_BACKING */
+struct ResourceAttachBacking {
+  GpuCtrlHeader header;
+  uint32_t resource_id;
+  uint32_t nr_entries;
+  MemEntry entry;
+} __attribute__((packed));
+
+struct SetScanout {
+  GpuCtrlHeader header;
+  GpuRect rect;
+  uint32_t scanout_id;
+  uint32_t resource_id;
+} __attribute__((packed));
+
+GpuRect ToGpuRect(const Rectangle<int> &rect) {
+  return {static_cast<uint32_t>(rect.pos.x), static_cast<uint32_t>(rect.pos.y),
+          static_cast<uint32_t>(rect.size.x),
+          static_cast<uint32_t>(rect.size.y)};
+}
+} // namespace
+// gpu_commands
+
+virtio::Gpu *virtio_gpu;
+
+namespace virtio {
+
+// gpu_initialize
+Error Gpu::Initialize(pci::Device &dev, const FrameBuffer &back_buffer) {
+  const auto &config = back_buffer.Config();
+  uint32_t format;
+  switch (config.pixel_format) {
+  case kPixelRGBResv8BitPerColor:
+    format = kFormatR8G8B8X8;
+    break;
+  case kPixelBGRResv8BitPerColor:
+    format = kFormatB8G8R8X8;
+    break;
+  default:
+    return MAKE_ERROR(Error::kUnknownPixelFormat);
+  }
+
+  if (auto err = transport_.Initialize(dev)) {
+    return err;
+  }
+  if (auto err = transport_.Negotiate(0)) {
+    return err;
+  }
+  if (auto err = transport_.SetupQueue(kControlQueue, control_queue_)) {
+    return err;
+  }
+  transport_.DriverOK();
+
+  // 裏付けメモリの1行の長さとリソースの幅を一致させ，
+  // バックバッファの座標をそのままリソースの座標として使えるようにする
+  ResourceCreate2D create{};
+  create.header.type = kCmdResourceCreate2D;
+  create.resource_id = kResourceID;
+  create.format = format;
+  create.width = config.pixels_per_scan_line;
+  create.height = config.vertical_resolution;
+  if (auto err = Execute(&create, sizeof(create))) {
+    return err;
+  }
+
+  ResourceAttachBacking attach{};
+  attach.header.type = kCmdResourceAttachBacking;
+  attach.resource_id = kResourceID;
+  attach.nr_entries = 1;
+  attach.entry.addr = reinterpret_cast<uint64_t>(config.frame_buffer);
+  attach.entry.length = kBytesPerPixel * config.pixels_per_scan_line *
+                        config.vertical_resolution;
+  if (auto err = Execute(&attach, sizeof(attach))) {
+    return err;
+  }
+
+  width_ = config.horizontal_resolution;
+  height_ = config.vertical_resolution;
+  SetScanout scanout{};
+  scanout.header.type = kCmdSetScanout;
+  scanout.rect = ToGpuRect({{0, 0}, {width_, height_}});
+  scanout.scanout_id = kScanoutID;
+  scanout.resource_id = kResourceID;
+  if (auto err = Execute(&scanout, sizeof(scanout))) {
+    return err;
+  }
+
+  // ホスト側のリソースは空なので，最初に画面全体を転送する
+  Present(back_buffer, {{0, 0}, {width_, height_}});
+  return MAKE_ERROR(Error::kSuccess);
+}
+// gpu_initialize
+
+// gpu_present
+unsigned long Gpu::Present(const FrameBuffer &src,
+                           const Rectangle<int> &area) {
+  if (failed_) {
+    return 0;
+  }
+  const auto &config = src.Config();
+  transfer_ = {};
+  transfer_.header.type = kCmdTransferToHost2D;
+  transfer_.rect = ToGpuRect(area);
+  transfer_.offset =
+      kBytesPerPixel *
+      (static_cast<uint64_t>(config.pixels_per_scan_line) * area.pos.y +
+       area.pos.x);
+  transfer_.resource_id = kResourceID;
+
+  flush_ = {};
+  flush_.header.type = kCmdResourceFlush;
+  flush_.rect = transfer_.rect;
+  flush_.resource_id = kResourceID;
+
+  // 2つのコマンドを続けてキューに入れ，通知は1回で済ませる
+  Error err = Push(&transfer_, sizeof(transfer_), responses_[0]);
+  if (!err) {
+    err = Push(&flush_, sizeof(flush_), responses_[1]);
+  }
+  if (!err) {
+    err = Wait(responses_, 2);
+  }
+  if (err) {
+    Log(failed_ ? kError : kWarn,
+        "virtio-gpu: failed to present: %s at %s:%d\n", err.Name(), err.File(),
+        err.Line());
+    return 0;
+  }
+  return static_cast<unsigned long>(area.size.x) * area.size.y;
+}
+// gpu_present
+
+Error Gpu::Execute(const void *command, uint32_t bytes) {
+  if (auto err = Push(command, bytes, responses_[0])) {
+    return err;
+  }
+  return Wait(responses_, 1);
+}
+
+Error Gpu::Push(const void *command, uint32_t bytes, GpuCtrlHeader &response) {
+  response = {};
+  const Buffer buffers[2] = {
+      {command, bytes, false},
+      {&response, sizeof(response), true},
+  };
+  if (auto err = control_queue_.Push(buffers, 2)) {
+    return err;
+  }
+  ++commands_;
+  return MAKE_ERROR(Error::kSuccess);
+}
+
+Error Gpu::Wait(GpuCtrlHeader *responses, int count) {
+  control_queue_.Kick();
+  // コントロールキューのコマンドは順に処理されるので，個数だけ待てばよい
+  for (int i = 0; i < count; ++i) {
+    if (auto err = control_queue_.WaitPop()) {
+      failed_ = true;
+      if (auto reset_err = transport_.Reset()) {
+        Log(kError, "virtio-gpu: failed to reset: %s at %s:%d\n",
+            reset_err.Name(), reset_err.File(), reset_err.Line());
+      }
+      return err;
+    }
+  }
+  for (int i = 0; i < count; ++i) {
+    if (responses[i].type != kRespOKNoData) {
+      return MAKE_ERROR(Error::kTransferFailed);
+    }
+  }
+  return MAKE_ERROR(Error::kSuccess);
+}
+
+} // namespace virtio
@@ -0,0 +1,107 @@
+/**
+ * @file virtio/gpu.hpp
+ *
+ * virtio-gpu の 2D コマンドを使う表示装置のドライバ。
+ * 合成先のバックバッファをそのままホスト側リソースの裏付けメモリとして登録し，
+ * Present では変化した矩形だけを転送して画面に反映させる。
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "error.hpp"
+#include "frame_buffer.hpp"
+#include "pci.hpp"
+#include "scanout.hpp"
+#include "virtio/transport.hpp"
+#include "virtio/queue.hpp"
+
+namespace virtio {
+
+/** @brief virtio-gpu のコマンドやレスポンスの先頭に付くヘッダ */
+struct GpuCtrlHeader {
+  uint32_t type;
+  uint32_t flags;
+  uint64_t fence_id;
+  uint32_t ctx_id;
+  uint8_t ring_idx;
+  uint8_t padding[3];
+} __attribute__((packed));
+
+/** @brief virtio-gpu のコマンドで使う矩形 */
+struct GpuRect {
+  uint32_t x, y, width, height;
+} __attribute__((packed));
+
+/** @brief VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D */
+struct GpuTransferToHost2D {
+  GpuCtrlHeader header;
+  GpuRect rect;
+  /** @brief 裏付けメモリの中で rect の左上のピクセルがある位置 */
+  uint64_t offset;
+  uint32_t resource_id;
+  uint32_t padding;
+} __attribute__((packed));
+
+/** @brief VIRTIO_GPU_CMD_RESOURCE_FLUSH */
+struct GpuResourceFlush {
+  GpuCtrlHeader header;
+  GpuRect rect;
+  uint32_t resource_id;
+  uint32_t padding;
+} __attribute__((packed));
+
+/** @brief virtio-gpu の 2D 表示装置 */
+class Gpu : public Scanout {
+public:
+  static const uint16_t kDeviceID = kModernDeviceIDBase + 16;
+
+  /** @brief dev を初期化し，back_buffer を表示するリソースを作る
+   *
+   * back_buffer のメモリをリソースの裏付けメモリとして登録するので，
+   * 以降の Present には back_buffer を渡さなければならない
+   */
+  Error Initialize(pci::Device &dev, const FrameBuffer &back_buffer);
+
+  /** @brief src の area の範囲だけをホストへ転送し，画面に反映させる
+   *
+   * TRANSFER_TO_HOST_2D と RESOURCE_FLUSH を続けて発行し，
+   * 両方が完了するまで待つ
+   */
+  virtual unsigned long Present(const FrameBuffer &src,
+                                const Rectangle<int> &area) override;
+
+  /** @brief デバイスが応答しなくなった場合に true を返す */
+  virtual bool Failed() const override { return failed_; }
+
+  /** @brief これまでに発行したコマンドの数を返す */
+  unsigned long Commands() const { return commands_; }
+
+private:
+  /** @brief コマンドを1つ送り，レスポンスを待つ */
+  Error Execute(const void *command, uint32_t bytes);
+  /** @brief コマンドをレスポンスの受け取り先と合わせてキューに追加する */
+  Error Push(const void *command, uint32_t bytes, GpuCtrlHeader &response);
+  /** @brief 追加したコマンドをデバイスに通知し，count 個のレスポンスを待つ
+   *
+   * レスポンスが返ってこなければデバイスをリセットして使用をやめる。
+   * 返ってこなかったコマンドやレスポンスの領域はデバイスがまだ読み書き
+   * するかもしれないので，以降は使わない
+   */
+  Error Wait(GpuCtrlHeader *responses, int count);
+
+  PCITransport transport_{};
+  Queue control_queue_{};
+  /** @brief Present が発行するコマンド。デバイスが読み終えるまで残しておく */
+  GpuTransferToHost2D transfer_{};
+  GpuResourceFlush flush_{};
+  GpuCtrlHeader responses_[2]{};
+  int width_{0}, height_{0};
+  unsigned long commands_{0};
+  bool failed_{false};
+};
+
+} // namespace virtio
+
+extern virtio::Gpu *virtio_gpu;
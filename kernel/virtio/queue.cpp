@@ -0,0 +1,163 @@
+#include "virtio/queue.hpp"
+
+#include <cstring>
+
+#include "memory_manager.hpp"
+
+// queue_layout
+namespace {
+/** @brief available ring の flags と idx の分のバイト数 */
+const size_t kRingHeaderBytes = 4;
+/** @brief used ring を WaitPop がポーリングする回数の上限 */
+const unsigned long kWaitSpinLimit = 100'000'000;
+
+size_t AlignUp(size_t value, size_t align) {
+  return (value + align - 1) / align * align;
+}
+
+/** @brief キューのメモリの中での各リングの位置と全体の大きさ */
+struct Layout {
+  size_t avail, used, bytes;
+};
+
+Layout CalcLayout(uint16_t size) {
+  Layout layout;
+  layout.avail = sizeof(virtio::Descriptor) * size;
+  // available ring の末尾には used_event が続く
+  const size_t avail_bytes = kRingHeaderBytes + 2 * size + 2;
+  layout.used = AlignUp(layout.avail + avail_bytes, 4);
+  // used ring の要素は {id: uint32, len: uint32}。末尾には avail_event が続く
+  const size_t used_bytes = kRingHeaderBytes + 8 * size + 2;
+  layout.bytes = layout.used + used_bytes;
+  return layout;
+}
+} // namespace
+// queue_layout
+
+namespace virtio {
+
+// queue_initialize
+Error Queue::Initialize(uint16_t size) {
+  if (size == 0 || size > kMaxSize || (size & (size - 1)) != 0) {
+    return MAKE_ERROR(Error::kInvalidDescriptor);
+  }
+  const auto layout = CalcLayout(size);
+  const size_t num_frames =
+      AlignUp(layout.bytes, kBytesPerFrame) / kBytesPerFrame;
+  const auto frame = memory_manager->Allocate(num_frames);
+  if (frame.error) {
+    return frame.error;
+  }
+  auto base = reinterpret_cast<uint8_t *>(frame.value.Frame());
+  memset(base, 0, num_frames * kBytesPerFrame);
+
+  size_ = size;
+  desc_ = reinterpret_cast<Descriptor *>(base);
+  avail_ = reinterpret_cast<volatile uint16_t *>(base + layout.avail);
+  used_ = reinterpret_cast<volatile uint16_t *>(base + layout.used);
+
+  // 空きディスクリプタは next でつないだリストとして持つ
+  for (uint16_t i = 0; i < size; ++i) {
+    desc_[i].next = i + 1;
+  }
+  free_head_ = 0;
+  num_free_ = size;
+  avail_idx_ = 0;
+  last_used_idx_ = 0;
+  return MAKE_ERROR(Error::kSuccess);
+}
+// queue_initialize
+
+void Queue::SetNotifyAddress(volatile uint16_t *notify,
+                             uint16_t queue_index) {
+  notify_ = notify;
+  queue_index_ = queue_index;
+}
+
+// queue_push
+Error Queue::Push(const Buffer *buffers, int count) {
+  if (count <= 0 || count > num_free_) {
+    return MAKE_ERROR(Error::kFull);
+  }
+
+  // 空きリストの先頭から count 個を取り出す。リストをつなぐ next が
+  // そのままチェーンの next になる
+  const uint16_t head = free_head_;
+  for (int i = 0; i < count; ++i) {
+    auto &desc = desc_[free_head_];
+    desc.addr = reinterpret_cast<uint64_t>(buffers[i].addr);
+    desc.len = buffers[i].len;
+    desc.flags = buffers[i].device_writable ? kDescWrite : 0;
+    if (i + 1 < count) {
+      desc.flags |= kDescNext;
+    }
+    free_head_ = desc.next;
+  }
+  num_free_ -= count;
+  chain_length_[head] = count;
+
+  avail_[2 + avail_idx_ % size_] = head;
+  // ring の要素を書いてから idx を進める
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  ++avail_idx_;
+  avail_[1] = avail_idx_;
+  return MAKE_ERROR(Error::kSuccess);
+}
+// queue_push
+
+void Queue::Kick() {
+  // idx の更新が通知より先にデバイスから見えるようにする
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if ((used_[0] & kUsedNoNotify) == 0) {
+    *notify_ = queue_index_;
+  }
+}
+
+// queue_pop
+Error Queue::Pop() {
+  if (used_[1] == last_used_idx_) {
+    return MAKE_ERROR(Error::kEmpty);
+  }
+  // idx を読んでから要素を読む
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  auto elements = reinterpret_cast<volatile uint32_t *>(used_ + 2);
+  const auto head =
+      static_cast<uint16_t>(elements[2 * (last_used_idx_ % size_)]);
+  ++last_used_idx_;
+
+  // チェーンを空きリストの先頭に戻す
+  uint16_t last = head;
+  for (int i = 1; i < chain_length_[head]; ++i) {
+    last = desc_[last].next;
+  }
+  desc_[last].next = free_head_;
+  free_head_ = head;
+  num_free_ += chain_length_[head];
+  return MAKE_ERROR(Error::kSuccess);
+}
+
+Error Queue::WaitPop() {
+  for (unsigned long i = 0; i < kWaitSpinLimit; ++i) {
+    auto err = Pop();
+    if (err.Cause() != Error::kEmpty) {
+      return err;
+    }
+    __builtin_ia32_pause();
+  }
+  return MAKE_ERROR(Error::kTimeout);
+}
+// queue_pop
+
+uint64_t Queue::DescriptorAddress() const {
+  return reinterpret_cast<uint64_t>(desc_);
+}
+
+uint64_t Queue::DriverAddress() const {
+  return reinterpret_cast<uint64_t>(avail_);
+}
+
+uint64_t Queue::DeviceAddress() const {
+  return reinterpret_cast<uint64_t>(used_);
+}
+
+} // namespace virtio
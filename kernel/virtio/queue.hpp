@@ -0,0 +1,99 @@
+/**
+ * @file virtio/queue.hpp
+ *
+ * virtio の split virtqueue。ドライバからデバイスへバッファの並びを渡し，
+ * デバイスが使い終えたものを受け取る。デバイスの種類に依存しないので，
+ * virtio のドライバで共通に使う。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "error.hpp"
+
+namespace virtio {
+
+/** @brief ディスクリプタ（1つのバッファ） */
+struct Descriptor {
+  uint64_t addr;
+  uint32_t len;
+  uint16_t flags;
+  uint16_t next;
+} __attribute__((packed));
+
+/** @brief Descriptor::flags のビット */
+const uint16_t kDescNext = 1;
+const uint16_t kDescWrite = 2;
+
+/** @brief Queue::Push に渡すバッファ */
+struct Buffer {
+  const void *addr;
+  uint32_t len;
+  /** @brief デバイスが書き込むバッファなら true */
+  bool device_writable;
+};
+
+/** @brief used ring の flags のビット。デバイスが通知を不要としている */
+const uint16_t kUsedNoNotify = 1;
+
+/** @brief split virtqueue を表すクラス */
+class Queue {
+public:
+  /** @brief ドライバが使うディスクリプタの数の上限 */
+  static const uint16_t kMaxSize = 64;
+
+  /** @brief size 個のディスクリプタを持つキューのメモリを確保する
+   *
+   * size は kMaxSize 以下の 2 のべき乗でなければならない
+   */
+  Error Initialize(uint16_t size);
+  /** @brief キューへ通知するときに書き込むレジスタを設定する */
+  void SetNotifyAddress(volatile uint16_t *notify, uint16_t queue_index);
+
+  /** @brief buffers の count 個のバッファを1つのチェーンとしてキューに追加する
+   *
+   * デバイスへは Kick() を呼ぶまで通知しない。
+   * 空きディスクリプタが足りなければ Error::kFull を返す
+   */
+  Error Push(const Buffer *buffers, int count);
+  /** @brief 追加したチェーンがあることをデバイスに通知する */
+  void Kick();
+  /** @brief デバイスが使い終えたチェーンを1つ取り出す
+   *
+   * 使い終えたチェーンが無ければ Error::kEmpty を返す
+   */
+  Error Pop();
+  /** @brief デバイスが使い終えるまで待ってチェーンを1つ取り出す
+   *
+   * 割り込みを使わず，used ring をポーリングする。
+   * 一定回数待っても返ってこなければ Error::kTimeout を返す
+   */
+  Error WaitPop();
+
+  uint16_t Size() const { return size_; }
+  /** @brief ディスクリプタテーブル，available ring，used ring の物理アドレス */
+  uint64_t DescriptorAddress() const;
+  uint64_t DriverAddress() const;
+  uint64_t DeviceAddress() const;
+
+private:
+  uint16_t size_{0};
+  Descriptor *desc_{nullptr};
+  /** @brief available ring。flags, idx, ring[size_] の順に並ぶ */
+  volatile uint16_t *avail_{nullptr};
+  /** @brief used ring。flags, idx の後に {id, len} が size_ 個並ぶ */
+  volatile uint16_t *used_{nullptr};
+  volatile uint16_t *notify_{nullptr};
+  uint16_t queue_index_{0};
+
+  uint16_t free_head_{0};
+  uint16_t num_free_{0};
+  uint16_t avail_idx_{0};
+  uint16_t last_used_idx_{0};
+  /** @brief 各チェーンの先頭のディスクリプタから，チェーンの長さを引く表 */
+  uint8_t chain_length_[kMaxSize]{};
+};
+
+} // namespace virtio
@@ -0,0 +1,183 @@
+#include "virtio/transport.hpp"
+
+#include <algorithm>
+
+#include "paging.hpp"
+
+// virtio_capability
+namespace {
+const uint8_t kCapabilityVendor = 0x09;
+
+/** @brief ベンダ固有ケーパビリティの cfg_type */
+const uint8_t kCommonConfig = 1;
+const uint8_t kNotifyConfig = 2;
+const uint8_t kDeviceConfig = 4;
+
+/** @brief device_status のビット */
+const uint8_t kStatusAcknowledge = 1;
+const uint8_t kStatusDriver = 2;
+const uint8_t kStatusDriverOK = 4;
+const uint8_t kStatusFeaturesOK = 8;
+const uint8_t kStatusFailed = 128;
+
+/** @brief Reset がリセットの完了を待つ回数の上限 */
+const unsigned long kResetSpinLimit = 100'000'000;
+
+/** @brief ケーパビリティが指す BAR の中の領域 */
+struct Region {
+  uint64_t addr, length;
+};
+
+/** @brief addr のケーパビリティが指す領域の物理アドレスを求める */
+WithError<Region> ReadRegion(pci::Device &dev, uint8_t addr) {
+  const auto bar_index = pci::ReadConfigReg(dev, addr + 4) & 0xffu;
+  const auto bar = pci::ReadBar(dev, bar_index);
+  if (bar.error) {
+    return {{}, bar.error};
+  }
+  // IO 空間の BAR は使わない
+  if (bar.value & 1) {
+    return {{}, MAKE_ERROR(Error::kNotImplemented)};
+  }
+  const uint64_t offset = pci::ReadConfigReg(dev, addr + 8);
+  const uint64_t length = pci::ReadConfigReg(dev, addr + 12);
+  const Region region{(bar.value & ~static_cast<uint64_t>(0xf)) + offset,
+                      length};
+
+  // 64 ビットの BAR は恒等写像の範囲より上に置かれることがある
+  const uint64_t mapped_end = kPageDirectoryCount * (1ull << 30);
+  if (region.addr + region.length > mapped_end) {
+    return {{}, MAKE_ERROR(Error::kIndexOutOfRange)};
+  }
+  return {region, MAKE_ERROR(Error::kSuccess)};
+}
+} // namespace
+// virtio_capability
+
+namespace virtio {
+
+// transport_initialize
+Error PCITransport::Initialize(pci::Device &dev) {
+  common_ = nullptr;
+  notify_base_ = nullptr;
+  device_config_ = nullptr;
+
+  uint8_t cap_addr = pci::ReadConfigReg(dev, 0x34) & 0xffu;
+  while (cap_addr != 0) {
+    auto header = pci::ReadCapabilityHeader(dev, cap_addr);
+    if (header.bits.cap_id == kCapabilityVendor) {
+      // cap フィールドの上位 8 ビットが cfg_type
+      const uint8_t cfg_type = header.bits.cap >> 8;
+      if (cfg_type == kCommonConfig || cfg_type == kNotifyConfig ||
+          cfg_type == kDeviceConfig) {
+        const auto region = ReadRegion(dev, cap_addr);
+        if (region.error) {
+          return region.error;
+        }
+        // MMIO の読み書きをキャッシュさせない
+        const auto addr = region.value.addr;
+        SetCacheType(addr, region.value.length, CacheType::kUncached);
+        if (cfg_type == kCommonConfig) {
+          common_ = reinterpret_cast<volatile CommonConfig *>(addr);
+        } else if (cfg_type == kNotifyConfig) {
+          notify_base_ = reinterpret_cast<volatile uint8_t *>(addr);
+          notify_off_multiplier_ = pci::ReadConfigReg(dev, cap_addr + 16);
+        } else {
+          device_config_ = reinterpret_cast<volatile void *>(addr);
+        }
+      }
+    }
+    cap_addr = header.bits.next_ptr;
+  }
+
+  if (common_ == nullptr || notify_base_ == nullptr) {
+    return MAKE_ERROR(Error::kUnknownDevice);
+  }
+  return MAKE_ERROR(Error::kSuccess);
+}
+// transport_initialize
+
+// transport_negotiate
+Error PCITransport::Negotiate(uint64_t features) {
+  if (auto err = Reset()) {
+    return err;
+  }
+  common_->device_status = kStatusAcknowledge;
+  common_->device_status = kStatusAcknowledge | kStatusDriver;
+
+  common_->device_feature_select = 0;
+  uint64_t device_features = common_->device_feature;
+  common_->device_feature_select = 1;
+  device_features |= static_cast<uint64_t>(common_->device_feature) << 32;
+  if ((device_features & kFeatureVersion1) == 0) {
+    common_->device_status = kStatusFailed;
+    return MAKE_ERROR(Error::kNotImplemented);
+  }
+
+  const uint64_t accepted = (features | kFeatureVersion1) & device_features;
+  common_->driver_feature_select = 0;
+  common_->driver_feature = accepted & 0xffffffffu;
+  common_->driver_feature_select = 1;
+  common_->driver_feature = accepted >> 32;
+
+  // デバイスが機能の組み合わせを受け入れたかは FEATURES_OK を読み戻して確かめる
+  common_->device_status =
+      kStatusAcknowledge | kStatusDriver | kStatusFeaturesOK;
+  if ((common_->device_status & kStatusFeaturesOK) == 0) {
+    common_->device_status = kStatusFailed;
+    return MAKE_ERROR(Error::kNotImplemented);
+  }
+  return MAKE_ERROR(Error::kSuccess);
+}
+// transport_negotiate
+
+// transport_setup_queue
+Error PCITransport::SetupQueue(uint16_t index, Queue &queue) {
+  if (index >= common_->num_queues) {
+    return MAKE_ERROR(Error::kIndexOutOfRange);
+  }
+  common_->queue_select = index;
+  const uint16_t device_size = common_->queue_size;
+  if (device_size == 0) {
+    return MAKE_ERROR(Error::kIndexOutOfRange);
+  }
+
+  const uint16_t size = std::min(device_size, Queue::kMaxSize);
+  if (auto err = queue.Initialize(size)) {
+    return err;
+  }
+  common_->queue_size = size;
+  common_->queue_desc_lo = queue.DescriptorAddress() & 0xffffffffu;
+  common_->queue_desc_hi = queue.DescriptorAddress() >> 32;
+  common_->queue_driver_lo = queue.DriverAddress() & 0xffffffffu;
+  common_->queue_driver_hi = queue.DriverAddress() >> 32;
+  common_->queue_device_lo = queue.DeviceAddress() & 0xffffffffu;
+  common_->queue_device_hi = queue.DeviceAddress() >> 32;
+
+  auto notify = notify_base_ +
+                static_cast<uint64_t>(common_->queue_notify_off) *
+                    notify_off_multiplier_;
+  queue.SetNotifyAddress(reinterpret_cast<volatile uint16_t *>(notify), index);
+  common_->queue_enable = 1;
+  return MAKE_ERROR(Error::kSuccess);
+}
+// transport_setup_queue
+
+Error PCITransport::Reset() {
+  // 0 を書き込むとリセットされる。リセットが終わると 0 が読める
+  common_->device_status = 0;
+  for (unsigned long i = 0; i < kResetSpinLimit; ++i) {
+    if (common_->device_status == 0) {
+      return MAKE_ERROR(Error::kSuccess);
+    }
+    __builtin_ia32_pause();
+  }
+  return MAKE_ERROR(Error::kTimeout);
+}
+
+void PCITransport::DriverOK() {
+  common_->device_status = kStatusAcknowledge | kStatusDriver |
+                           kStatusFeaturesOK | kStatusDriverOK;
+}
+
+} // namespace virtio
@@ -0,0 +1,90 @@
+/**
+ * @file virtio/transport.hpp
+ *
+ * virtio 1.0 以降の PCI トランスポート（modern インターフェース）。
+ * ベンダ固有ケーパビリティから各設定領域の MMIO の位置を見つけ，
+ * 機能のネゴシエーションと virtqueue の登録を行う。
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "error.hpp"
+#include "pci.hpp"
+#include "virtio/queue.hpp"
+
+namespace virtio {
+
+/** @brief virtio デバイスの PCI ベンダ ID */
+const uint16_t kVendorID = 0x1af4;
+/** @brief modern インターフェースのデバイス ID は，この値に種類の番号を足す */
+const uint16_t kModernDeviceIDBase = 0x1040;
+
+/** @brief 機能ビット。virtio 1.0 以降の仕様に従う */
+const uint64_t kFeatureVersion1 = 1ull << 32;
+
+/** @brief modern インターフェースの共通設定領域 */
+struct CommonConfig {
+  uint32_t device_feature_select;
+  uint32_t device_feature;
+  uint32_t driver_feature_select;
+  uint32_t driver_feature;
+  uint16_t config_msix_vector;
+  uint16_t num_queues;
+  uint8_t device_status;
+  uint8_t config_generation;
+
+  uint16_t queue_select;
+  uint16_t queue_size;
+  uint16_t queue_msix_vector;
+  uint16_t queue_enable;
+  uint16_t queue_notify_off;
+  // 64 ビットのフィールドは 32 ビットずつ書き込む
+  uint32_t queue_desc_lo, queue_desc_hi;
+  uint32_t queue_driver_lo, queue_driver_hi;
+  uint32_t queue_device_lo, queue_device_hi;
+} __attribute__((packed));
+
+/** @brief virtio デバイスの PCI トランスポート */
+class PCITransport {
+public:
+  /** @brief dev のケーパビリティから共通設定，通知，デバイス固有設定の
+   * 各領域を探す
+   *
+   * 領域が見つからない場合や，恒等写像していないアドレスにある場合は
+   * エラーを返す
+   */
+  Error Initialize(pci::Device &dev);
+
+  /** @brief デバイスをリセットし，features のうちデバイスが対応している
+   * 機能を有効にする
+   *
+   * kFeatureVersion1 に対応していないデバイスはエラーとする
+   */
+  Error Negotiate(uint64_t features);
+  /** @brief index 番目の virtqueue を用意してデバイスに登録する
+   *
+   * キューの大きさはデバイスの上限と Queue::kMaxSize の小さい方
+   */
+  Error SetupQueue(uint16_t index, Queue &queue);
+  /** @brief 初期化の完了をデバイスに伝える */
+  void DriverOK();
+  /** @brief デバイスをリセットする
+   *
+   * リセットが終わるとデバイスは virtqueue のバッファを使わなくなる。
+   * 一定回数待ってもリセットが終わらなければ Error::kTimeout を返す
+   */
+  Error Reset();
+
+  /** @brief デバイス固有の設定領域 */
+  volatile void *DeviceConfig() const { return device_config_; }
+
+private:
+  volatile CommonConfig *common_{nullptr};
+  volatile uint8_t *notify_base_{nullptr};
+  uint32_t notify_off_multiplier_{0};
+  volatile void *device_config_{nullptr};
+};
+
+} // namespace virtio
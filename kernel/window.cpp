@@ -1,24 +1,38 @@
 #include "window.hpp"
+#include "blit.hpp"
 #include "font.hpp"
 #include "frame_buffer.hpp"
 #include "frame_buffer_config.hpp"
 #include "graphics.hpp"
+#include "image.hpp"
 #include "logger.hpp"
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 
 // window_ctor
-Window::Window(int width, int height, PixelFormat shadow_format)
-    : width_{width}, height_{height} {
-  data_.resize(height);
-  for (int y = 0; y < height; ++y) {
-    data_[y].resize(width);
+Window::Window(int width, int height, PixelFormat shadow_format,
+               Surface surface)
+    : width_{width}, height_{height}, surface_{surface},
+      format_{shadow_format} {
+  opaque_spans_.resize(height);
+  spans_dirty_.resize(height, true);
+
+  if (surface_ == Surface::kIndexed) {
+    indices_.resize(static_cast<size_t>(width) * height);
+    palette_[0] = ToNativePixel(format_, {0, 0, 0});
+    palette_size_ = 1;
+    return;
   }
+  InitializeShadowBuffer();
+}
 
+void Window::InitializeShadowBuffer() {
   FrameBufferConfig config{};
   config.frame_buffer = nullptr;
-  config.horizontal_resolution = width;
-  config.vertical_resolution = height;
-  config.pixel_format = shadow_format;
+  config.horizontal_resolution = width_;
+  config.vertical_resolution = height_;
+  config.pixel_format = format_;
 
   if (auto err = shadow_buffer_.Initialize(config)) {
     Log(kError, "failed to initialize shadow buffer: %s at %s:%d\n", err.Name(),
@@ -27,75 +41,472 @@ Window::Window(int width, int height, PixelFormat shadow_format)
 }
 // window_ctor
 
+// window_palette
+std::optional<uint8_t> Window::PaletteIndex(const PixelColor &c) {
+  const auto native = ToNativePixel(format_, c);
+  if (palette_[last_index_] == native) {
+    return last_index_;
+  }
+  for (int i = 0; i < palette_size_; ++i) {
+    if (palette_[i] == native) {
+      last_index_ = i;
+      return last_index_;
+    }
+  }
+  if (palette_size_ == kPaletteSize) {
+    return std::nullopt;
+  }
+  palette_[palette_size_] = native;
+  last_index_ = palette_size_++;
+  return last_index_;
+}
+
+bool Window::PrepareIndices(const PixelColor *colors, uint8_t *indices,
+                            int count) {
+  if (surface_ != Surface::kIndexed) {
+    return false;
+  }
+  for (int i = 0; i < count; ++i) {
+    const auto index = PaletteIndex(colors[i]);
+    if (!index) {
+      ConvertToDirect();
+      return false;
+    }
+    indices[i] = *index;
+  }
+  return true;
+}
+
+void Window::ConvertToDirect() {
+  InitializeShadowBuffer();
+  for (int y = 0; y < height_; ++y) {
+    ExpandIndices(PixelAt({0, y}), IndexAt({0, y}), width_);
+  }
+  surface_ = Surface::kDirect;
+  indices_ = std::vector<uint8_t>{};
+  std::fill(spans_dirty_.begin(), spans_dirty_.end(), true);
+}
+
+void Window::ExpandIndices(uint32_t *dst, const uint8_t *src,
+                           int count) const {
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    dst[i + 0] = palette_[src[i + 0]];
+    dst[i + 1] = palette_[src[i + 1]];
+    dst[i + 2] = palette_[src[i + 2]];
+    dst[i + 3] = palette_[src[i + 3]];
+  }
+  for (; i < count; ++i) {
+    dst[i] = palette_[src[i]];
+  }
+}
+// window_palette
+
 // window_drawto
-void Window::DrawTo(FrameBuffer &dst, Vector2D<int> position) {
+void Window::DrawTo(FrameBuffer &dst, Vector2D<int> position,
+                    const Rectangle<int> &area, uint8_t alpha) {
+  const Rectangle<int> window_area{position, Size()};
+  const auto intersection = area & window_area;
+  if (alpha != 255 || !alpha_.empty()) {
+    DrawBlendedTo(dst, position, intersection, alpha);
+    return;
+  }
+  if (surface_ == Surface::kIndexed) {
+    DrawIndexedTo(dst, position, intersection);
+    return;
+  }
+  const auto start = intersection.pos - position;
+  const auto end = start + intersection.size;
   if (!transparent_color_) {
-    dst.Copy(position, shadow_buffer_);
+    // 先頭行が途中にある場合は，折り返した前後の2つに分けてコピーする
+    ForEachRowRun(start.y, intersection.size.y, [&](int y, int py, int rows) {
+      dst.Copy(position + Vector2D<int>{start.x, y}, shadow_buffer_,
+               {{start.x, py}, {intersection.size.x, rows}});
+    });
     return;
   }
 
-  const auto tc = transparent_color_.value();
-  auto &writer = dst.Writer();
-  for (int y = std::max(0, 0 - position.y);
-       y < std::min(Height(), writer.Height() - position.y); ++y) {
-    for (int x = std::max(0, 0 - position.x);
-         x < std::min(Width(), writer.Width() - position.x); ++x) {
-      const auto c = At(Vector2D<int>{x, y});
-      if (c != tc) {
-        writer.Write(position + Vector2D<int>{x, y}, c);
+  // 不透明なピクセルの並びごとに影バッファからコピーする
+  for (int y = start.y; y < end.y; ++y) {
+    const int py = PhysicalRow(y);
+    if (spans_dirty_[py]) {
+      UpdateOpaqueSpans(y);
+    }
+    for (const auto &span : opaque_spans_[py]) {
+      const int begin = std::max(span.begin, start.x);
+      const int end_x = std::min(span.end, end.x);
+      if (begin >= end_x) {
+        continue;
       }
+      dst.Copy(position + Vector2D<int>{begin, y}, shadow_buffer_,
+               {{begin, py}, {end_x - begin, 1}});
     }
   }
 }
+
+void Window::DrawIndexedTo(FrameBuffer &dst, Vector2D<int> position,
+                           const Rectangle<int> &area) {
+  const auto &dst_config = dst.Config();
+  if (dst_config.pixel_format != format_) {
+    return;
+  }
+  const Rectangle<int> dst_rect{
+      {0, 0},
+      {static_cast<int>(dst_config.horizontal_resolution),
+       static_cast<int>(dst_config.vertical_resolution)}};
+  const auto draw_area = area & dst_rect;
+  if (IsEmpty(draw_area)) {
+    return;
+  }
+
+  // パレットを引きながら描画先のピクセル形式へ展開する
+  auto dst_row = reinterpret_cast<uint32_t *>(dst_config.frame_buffer) +
+                 dst_config.pixels_per_scan_line * draw_area.pos.y;
+  const auto start = draw_area.pos - position;
+  const auto end = start + draw_area.size;
+  for (int y = start.y; y < end.y;
+       ++y, dst_row += dst_config.pixels_per_scan_line) {
+    if (!transparent_color_) {
+      ExpandIndices(dst_row + draw_area.pos.x, IndexAt({start.x, y}),
+                    draw_area.size.x);
+      continue;
+    }
+    const int py = PhysicalRow(y);
+    if (spans_dirty_[py]) {
+      UpdateOpaqueSpans(y);
+    }
+    for (const auto &span : opaque_spans_[py]) {
+      const int begin = std::max(span.begin, start.x);
+      const int end_x = std::min(span.end, end.x);
+      if (begin < end_x) {
+        ExpandIndices(dst_row + position.x + begin, IndexAt({begin, y}),
+                      end_x - begin);
+      }
+    }
+  }
+}
+
+void Window::DrawBlendedTo(FrameBuffer &dst, Vector2D<int> position,
+                           const Rectangle<int> &area, uint8_t alpha) {
+  const auto &dst_config = dst.Config();
+  if (dst_config.pixel_format != format_) {
+    return;
+  }
+  const Rectangle<int> dst_rect{
+      {0, 0},
+      {static_cast<int>(dst_config.horizontal_resolution),
+       static_cast<int>(dst_config.vertical_resolution)}};
+  const auto draw_area = area & dst_rect;
+  if (IsEmpty(draw_area)) {
+    return;
+  }
+  if (surface_ == Surface::kIndexed) {
+    row_buffer_.resize(width_);
+  }
+
+  auto dst_row = reinterpret_cast<uint32_t *>(dst_config.frame_buffer) +
+                 dst_config.pixels_per_scan_line * draw_area.pos.y +
+                 position.x;
+  const auto start = draw_area.pos - position;
+  const auto end = start + draw_area.size;
+  const OpaqueSpan whole_row{start.x, end.x};
+  for (int y = start.y; y < end.y;
+       ++y, dst_row += dst_config.pixels_per_scan_line) {
+    const int py = PhysicalRow(y);
+    const OpaqueSpan *spans = &whole_row;
+    size_t num_spans = 1;
+    if (transparent_color_) {
+      if (spans_dirty_[py]) {
+        UpdateOpaqueSpans(y);
+      }
+      spans = opaque_spans_[py].data();
+      num_spans = opaque_spans_[py].size();
+    }
+    const uint8_t *mask = alpha_.empty() ? nullptr : &alpha_[width_ * py];
+
+    // 透過色ではないピクセルの並びごとに，まとめて重ねる
+    for (size_t i = 0; i < num_spans; ++i) {
+      const int begin = std::max(spans[i].begin, start.x);
+      const int end_x = std::min(spans[i].end, end.x);
+      if (begin >= end_x) {
+        continue;
+      }
+      const uint32_t *src = nullptr;
+      if (surface_ == Surface::kIndexed) {
+        ExpandIndices(row_buffer_.data(), IndexAt({begin, y}), end_x - begin);
+        src = row_buffer_.data();
+      } else {
+        src = PixelAt({begin, y});
+      }
+      blit_kernel->blend32(dst_row + begin, src, mask ? mask + begin : nullptr,
+                           end_x - begin, alpha);
+    }
+  }
+}
+
+void Window::UpdateOpaqueSpans(int y) {
+  auto &spans = opaque_spans_[PhysicalRow(y)];
+  spans.clear();
+  auto collect = [this, &spans](const auto *row, auto tc) {
+    int x = 0;
+    while (x < width_) {
+      if (row[x] == tc) {
+        ++x;
+        continue;
+      }
+      const int begin = x;
+      while (x < width_ && row[x] != tc) {
+        ++x;
+      }
+      spans.push_back({begin, x});
+    }
+  };
+
+  const auto tc = ToNativePixel(format_, transparent_color_.value());
+  if (surface_ == Surface::kDirect) {
+    collect(PixelAt({0, y}), tc);
+  } else if (auto it = std::find(palette_.begin(),
+                                 palette_.begin() + palette_size_, tc);
+             it != palette_.begin() + palette_size_) {
+    collect(IndexAt({0, y}), static_cast<uint8_t>(it - palette_.begin()));
+  } else {
+    // 透過色がパレットに無ければ行全体が不透明
+    spans.push_back({0, width_});
+  }
+  spans_dirty_[PhysicalRow(y)] = false;
+}
 // window_drawto
 
 // window_settc
 void Window::SetTransparentColor(std::optional<PixelColor> c) {
   transparent_color_ = c;
+  std::fill(spans_dirty_.begin(), spans_dirty_.end(), true);
 }
+
+bool Window::IsOpaque() const { return !transparent_color_ && alpha_.empty(); }
 // window_settc
 
+// window_alpha
+void Window::FillAlpha(const Rectangle<int> &rect, uint8_t alpha) {
+  if (alpha_.empty()) {
+    alpha_.resize(static_cast<size_t>(width_) * height_, 255);
+  }
+  const auto area = rect & Rectangle<int>{{0, 0}, Size()};
+  for (int y = area.pos.y; y < area.pos.y + area.size.y; ++y) {
+    memset(&alpha_[width_ * PhysicalRow(y) + area.pos.x], alpha, area.size.x);
+  }
+}
+
+bool Window::HasAlpha() const { return !alpha_.empty(); }
+
+uint8_t Window::AlphaAt(Vector2D<int> pos) const {
+  if (alpha_.empty()) {
+    return 255;
+  }
+  return alpha_[width_ * PhysicalRow(pos.y) + pos.x];
+}
+// window_alpha
+
 Window::WindowWriter *Window::Writer() { return &writer_; }
 
-const PixelColor &Window::At(Vector2D<int> pos) const {
-  return data_[pos.y][pos.x];
+PixelColor Window::At(Vector2D<int> pos) const {
+  if (surface_ == Surface::kIndexed) {
+    return FromNativePixel(format_, palette_[*IndexAt(pos)]);
+  }
+  return FromNativePixel(format_, *PixelAt(pos));
 }
 
 void Window::Write(Vector2D<int> pos, PixelColor c) {
-  data_[pos.y][pos.x] = c;
-  shadow_buffer_.Writer().Write(pos, c);
+  uint8_t index;
+  if (PrepareIndices(&c, &index, 1)) {
+    *IndexAt(pos) = index;
+  } else {
+    *PixelAt(pos) = ToNativePixel(format_, c);
+  }
+  MarkRowsDirty(pos.y, 1);
+}
+
+void Window::FillRect(const Rectangle<int> &rect, const PixelColor &c) {
+  const auto area = rect & Rectangle<int>{{0, 0}, Size()};
+  if (IsEmpty(area)) {
+    return;
+  }
+  uint8_t index;
+  if (PrepareIndices(&c, &index, 1)) {
+    for (int y = area.pos.y; y < area.pos.y + area.size.y; ++y) {
+      memset(IndexAt({area.pos.x, y}), index, area.size.x);
+    }
+  } else {
+    ForEachRowRun(area.pos.y, area.size.y, [&](int, int py, int rows) {
+      shadow_buffer_.Writer().FillRect({{area.pos.x, py}, {area.size.x, rows}},
+                                       c);
+    });
+  }
+  MarkRowsDirty(area.pos.y, area.size.y);
+}
+
+void Window::WriteSpan(Vector2D<int> pos, const PixelColor *colors,
+                       int length) {
+  if (pos.y < 0 || pos.y >= height_) {
+    return;
+  }
+  if (surface_ == Surface::kIndexed) {
+    const int begin = std::max(pos.x, 0);
+    const int end = std::min(pos.x + length, width_);
+    if (begin >= end) {
+      return;
+    }
+    if (PrepareIndices(colors + (begin - pos.x), IndexAt({begin, pos.y}),
+                       end - begin)) {
+      MarkRowsDirty(pos.y, 1);
+      return;
+    }
+  }
+  shadow_buffer_.Writer().WriteSpan({pos.x, PhysicalRow(pos.y)}, colors,
+                                    length);
+  MarkRowsDirty(pos.y, 1);
+}
+
+void Window::BlitRect(Vector2D<int> pos, const uint32_t *src, int src_stride,
+                      Vector2D<int> size, PixelFormat format) {
+  const auto area = Rectangle<int>{pos, size} & Rectangle<int>{{0, 0}, Size()};
+  if (IsEmpty(area)) {
+    return;
+  }
+  MarkRowsDirty(area.pos.y, area.size.y);
+  if (surface_ == Surface::kIndexed) {
+    // パレットに収まる間は1ピクセルずつ番号へ変換する。
+    // 文字画像のように同じ値が続くことが多いので直前の変換結果を使い回す
+    uint32_t prev_value = src[src_stride * (area.pos.y - pos.y) +
+                              (area.pos.x - pos.x)] ^
+                          1;
+    uint8_t prev_index = 0;
+    for (int y = area.pos.y; y < area.pos.y + area.size.y; ++y) {
+      const auto src_row = src + src_stride * (y - pos.y);
+      auto index_row = IndexAt({0, y});
+      for (int x = area.pos.x; x < area.pos.x + area.size.x; ++x) {
+        const auto value = src_row[x - pos.x];
+        if (value != prev_value) {
+          const auto c = FromNativePixel(format, value);
+          if (!PrepareIndices(&c, &prev_index, 1)) {
+            break;
+          }
+          prev_value = value;
+        }
+        index_row[x] = prev_index;
+      }
+      if (surface_ != Surface::kIndexed) {
+        break;
+      }
+    }
+    if (surface_ == Surface::kIndexed) {
+      return;
+    }
+  }
+  ForEachRowRun(area.pos.y, area.size.y, [&](int y, int py, int rows) {
+    const auto src_rows = src + src_stride * (y - pos.y);
+    shadow_buffer_.Writer().BlitRect({pos.x, py}, src_rows, src_stride,
+                                     {size.x, rows}, format);
+  });
+}
+
+void Window::BlendSpan(Vector2D<int> pos, const uint32_t *src, int length,
+                       PixelFormat format) {
+  if (pos.y < 0 || pos.y >= height_) {
+    return;
+  }
+  const int begin = std::max(pos.x, 0);
+  const int end = std::min(pos.x + length, width_);
+  // 半透明なピクセルは画像の縁などに限られるので1ピクセルずつ読んで書く
+  for (int x = begin; x < end; ++x) {
+    const auto value = ConvertNativePixel(format, format_, src[x - pos.x]);
+    const auto dst = ToNativePixel(format_, At({x, pos.y}));
+    Write({x, pos.y}, FromNativePixel(format_, BlendPremultiplied(dst, value)));
+  }
 }
 
 void Window::Move(Vector2D<int> dst_pos, const Rectangle<int> &src) {
-  shadow_buffer_.Move(dst_pos, src);
+  MarkRowsDirty(dst_pos.y, src.size.y);
+  // 行は折り返しているかもしれないので1行ずつ移す
+  auto move_row = [&](int y) {
+    const auto dst_row = dst_pos + Vector2D<int>{0, y};
+    const auto src_row = src.pos + Vector2D<int>{0, y};
+    if (surface_ == Surface::kIndexed) {
+      memmove(IndexAt(dst_row), IndexAt(src_row), src.size.x);
+    } else {
+      blit_kernel->move(PixelAt(dst_row), PixelAt(src_row), 4 * src.size.x);
+    }
+    if (!alpha_.empty()) {
+      memmove(&alpha_[width_ * PhysicalRow(dst_row.y) + dst_row.x],
+              &alpha_[width_ * PhysicalRow(src_row.y) + src_row.x],
+              src.size.x);
+    }
+  };
+  if (dst_pos.y < src.pos.y) {
+    for (int y = 0; y < src.size.y; ++y) {
+      move_row(y);
+    }
+  } else {
+    for (int y = src.size.y - 1; y >= 0; --y) {
+      move_row(y);
+    }
+  }
+}
+
+void Window::Scroll(int rows) {
+  origin_row_ = PhysicalRow(rows % height_);
+}
+
+int Window::PhysicalRow(int y) const {
+  y += origin_row_;
+  return y >= height_ ? y - height_ : y;
+}
+
+void Window::MarkRowsDirty(int y, int rows) {
+  for (int i = 0; i < rows; ++i) {
+    spans_dirty_[PhysicalRow(y + i)] = true;
+  }
 }
 
 int Window::Width() const { return width_; }
 
 int Window::Height() const { return height_; }
 
+Vector2D<int> Window::Size() const { return {width_, height_}; }
+
+PixelFormat Window::Format() const { return format_; }
+
+Window::Surface Window::SurfaceType() const { return surface_; }
+
+int Window::PaletteSize() const { return palette_size_; }
+
+uint32_t *Window::PixelAt(Vector2D<int> pos) {
+  const auto &config = shadow_buffer_.Config();
+  return reinterpret_cast<uint32_t *>(config.frame_buffer) +
+         config.pixels_per_scan_line * PhysicalRow(pos.y) + pos.x;
+}
+
+const uint32_t *Window::PixelAt(Vector2D<int> pos) const {
+  const auto &config = shadow_buffer_.Config();
+  return reinterpret_cast<const uint32_t *>(config.frame_buffer) +
+         config.pixels_per_scan_line * PhysicalRow(pos.y) + pos.x;
+}
+
+uint8_t *Window::IndexAt(Vector2D<int> pos) {
+  return &indices_[static_cast<size_t>(width_) * PhysicalRow(pos.y) + pos.x];
+}
+
+const uint8_t *Window::IndexAt(Vector2D<int> pos) const {
+  return &indices_[static_cast<size_t>(width_) * PhysicalRow(pos.y) + pos.x];
+}
+
+// assets/close_button.ppm を tools/makeimage.py で変換して埋め込んだもの
+extern const uint8_t _binary_assets_close_button_img_start[];
+extern const uint8_t _binary_assets_close_button_img_end[];
+
 // utils
 namespace {
-const int kCloseButtonWidth = 16;
-const int kCloseButtonHeight = 14;
-// clang-format off
-const char close_button[kCloseButtonHeight][kCloseButtonWidth + 1] = {
-    "...............@",
-    ".:::::::::::::$@",
-    ".:::::::::::::$@",
-    ".:::@@::::@@::$@",
-    ".::::@@::@@:::$@",
-    ".:::::@@@@::::$@",
-    ".::::::@@:::::$@",
-    ".:::::@@@@::::$@",
-    ".::::@@::@@:::$@",
-    ".:::@@::::@@::$@",
-    ".:::::::::::::$@",
-    ".:::::::::::::$@",
-    ".$$$$$$$$$$$$$$@",
-    "@@@@@@@@@@@@@@@@",
-  };
-// clang-format on
+Image close_button_image;
 
 /** 色決め */
 constexpr PixelColor ToColor(uint32_t c) {
@@ -132,18 +543,13 @@ void DrawWindow(PixelWriter &writer, const char *title) {
 
   WriteString(writer, {24, 4}, title, ToColor(0xffffff));
 
-  for (int y = 0; y < kCloseButtonHeight; ++y) {
-    for (int x = 0; x < kCloseButtonWidth; ++x) {
-      PixelColor c = ToColor(0xffffff);
-      if (close_button[y][x] == '@') {
-        c = ToColor(0x000000);
-      } else if (close_button[y][x] == '$') {
-        c = ToColor(0x848484);
-      } else if (close_button[y][x] == ':') {
-        c = ToColor(0xc6c6c6);
-      }
-      writer.Write({win_w - 5 - kCloseButtonWidth + x, 5 + y}, c);
-    }
+  if (auto err = LoadEmbeddedImage(close_button_image,
+                                   _binary_assets_close_button_img_start,
+                                   _binary_assets_close_button_img_end)) {
+    Log(kError, "failed to load the close button image: %s\n", err.Name());
+    return;
   }
+  close_button_image.DrawTo(writer,
+                            {win_w - 5 - close_button_image.Size().x, 5});
 }
 // draw_window
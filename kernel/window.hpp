@@ -10,6 +10,8 @@
 #include "frame_buffer_config.hpp"
 #include "graphics.hpp"
 
+#include <algorithm>
+#include <array>
 #include <optional>
 #include <vector>
 
@@ -34,38 +36,108 @@ public:
     virtual int Width() const override { return window_.Width(); }
     /** @brief Height は関連付けられた Window の高さをピクセル単位で返す。 */
     virtual int Height() const override { return window_.Height(); }
+    virtual PixelFormat Format() const override { return window_.Format(); }
+    /** @brief 関連付けられた Window の矩形領域をまとめて塗りつぶす */
+    virtual void FillRect(const Rectangle<int> &rect,
+                          const PixelColor &c) override {
+      window_.FillRect(rect, c);
+    }
+    virtual void FillSpan(Vector2D<int> pos, int length,
+                          const PixelColor &c) override {
+      window_.FillRect({pos, {length, 1}}, c);
+    }
+    virtual void WriteSpan(Vector2D<int> pos, const PixelColor *colors,
+                           int length) override {
+      window_.WriteSpan(pos, colors, length);
+    }
+    virtual void BlitRect(Vector2D<int> pos, const uint32_t *src,
+                          int src_stride, Vector2D<int> size,
+                          PixelFormat format) override {
+      window_.BlitRect(pos, src, src_stride, size, format);
+    }
+    virtual void BlendSpan(Vector2D<int> pos, const uint32_t *src, int length,
+                           PixelFormat format) override {
+      window_.BlendSpan(pos, src, length, format);
+    }
 
   private:
     Window &window_;
   };
   // #@@range_end(windowwriter)
 
+  /** @brief 平面描画領域のピクセルの持ち方 */
+  enum class Surface {
+    /** @brief 描画先と同じ 32 ビットのピクセル形式で持つ */
+    kDirect,
+    /** @brief 8 ビットのパレット番号で持ち，描画時に展開する。
+     * 使う色が 256 色を超えると kDirect に切り替わる */
+    kIndexed,
+  };
+
   /** @brief 指定されたピクセル数の平面描画領域を作成する。 */
-  Window(int width, int height, PixelFormat shadow_format);
+  Window(int width, int height, PixelFormat shadow_format,
+         Surface surface = Surface::kDirect);
   ~Window() = default;
   Window(const Window &rhs) = delete;
   Window &operator=(const Window &rhs) = delete;
 
   /** @brief dst描画先
    *
-   * @param writer  描画先
-   * @param position  writer の左上を基準とした描画位置
+   * @param dst  描画先
+   * @param position  dst の左上を基準とした描画位置
+   * @param area  dst の左上を基準とした描画範囲。範囲外には描画しない
+   * @param alpha  ウィンドウ全体の不透明度。255 未満なら dst の内容と重ねる
    */
-  void DrawTo(FrameBuffer &dst, Vector2D<int> position);
+  void DrawTo(FrameBuffer &dst, Vector2D<int> position,
+              const Rectangle<int> &area, uint8_t alpha = 255);
   /** @brief 透過色を設定する。 */
   void SetTransparentColor(std::optional<PixelColor> c);
+  /** @brief 透過するピクセルも半透明のピクセルも持たない場合に true を返す。
+   */
+  bool IsOpaque() const;
+  /** @brief 矩形領域のピクセルごとの不透明度を設定する。
+   *
+   * 初めて呼んだときにピクセルごとの不透明度を確保する（初期値は 255）。
+   * 色を書き込んでも不透明度は変わらない。
+   */
+  void FillAlpha(const Rectangle<int> &rect, uint8_t alpha);
+  /** @brief ピクセルごとの不透明度を持つ場合に true を返す。 */
+  bool HasAlpha() const;
+  /** @brief 指定した位置のピクセルの不透明度を返す。 */
+  uint8_t AlphaAt(Vector2D<int> pos) const;
   /** @brief このインスタンスに紐付いた WindowWriter を取得する。 */
   WindowWriter *Writer();
 
   /** @brief 指定した位置のピクセルを返す。 */
-  const PixelColor &At(Vector2D<int> pos) const;
+  PixelColor At(Vector2D<int> pos) const;
   /** @brief 指定した位置にピクセルを書き込む。 */
   void Write(Vector2D<int> pos, PixelColor c);
+  /** @brief 矩形領域を塗りつぶす。平面描画領域からはみ出した部分は無視する。 */
+  void FillRect(const Rectangle<int> &rect, const PixelColor &c);
+  /** @brief pos から右へ length ピクセル分の色を書き込む。
+   * 平面描画領域からはみ出した部分は無視する。 */
+  void WriteSpan(Vector2D<int> pos, const PixelColor *colors, int length);
+  /** @brief ネイティブ形式のピクセルが並んだ矩形を書き込む。
+   * 引数の意味は PixelWriter::BlitRect と同じ。 */
+  void BlitRect(Vector2D<int> pos, const uint32_t *src, int src_stride,
+                Vector2D<int> size, PixelFormat format);
+  /** @brief 不透明度を乗算済みのピクセルの並びを重ねる。
+   * 引数の意味は PixelWriter::BlendSpan と同じ。 */
+  void BlendSpan(Vector2D<int> pos, const uint32_t *src, int length,
+                 PixelFormat format);
 
   /** @brief 平面描画領域の横幅をピクセル単位で返す。 */
   int Width() const;
   /** @brief 平面描画領域の高さをピクセル単位で返す。 */
   int Height() const;
+  /** @brief 平面描画領域の大きさをピクセル単位で返す。 */
+  Vector2D<int> Size() const;
+  /** @brief 平面描画領域のピクセル形式を返す。 */
+  PixelFormat Format() const;
+  /** @brief 平面描画領域の現在のピクセルの持ち方を返す。 */
+  Surface SurfaceType() const;
+  /** @brief パレットに登録されている色の数を返す。 */
+  int PaletteSize() const;
 
   /** @brief このウィンドウの平面描画領域内で，矩形領域を移動する
    *
@@ -75,12 +147,101 @@ public:
    * */
   void Move(Vector2D<int> dst_pos, const Rectangle<int> &src);
 
+  /** @brief 内容全体を rows 行だけ上へ送る
+   *
+   * ピクセルは移動せず，先頭行として扱う行を変えるだけなので行数によらず速い。
+   * 上端から押し出された行は下端に回り込むので，呼び出し側で描き直すこと。
+   *
+   * @param rows  送る行数。0 以上
+   */
+  void Scroll(int rows);
+
 private:
+  /** @brief 1行の中で透過色ではないピクセルが連続する範囲 [begin, end) */
+  struct OpaqueSpan {
+    int begin, end;
+  };
+
+  static const int kPaletteSize = 256;
+
   int width_, height_;
-  std::vector<std::vector<PixelColor>> data_{};
+  Surface surface_;
+  PixelFormat format_;
   WindowWriter writer_{*this};
   std::optional<PixelColor> transparent_color_{std::nullopt};
+  /** @brief kDirect のときのウィンドウの内容。
+   * 描画先と同じピクセル形式で1つの連続した領域に持つ */
   FrameBuffer shadow_buffer_{};
+  /** @brief kIndexed のときのウィンドウの内容。1ピクセル1バイトの番号 */
+  std::vector<uint8_t> indices_{};
+  /** @brief パレット番号からネイティブ形式のピクセル値への変換表 */
+  std::array<uint32_t, kPaletteSize> palette_{};
+  int palette_size_{0};
+  /** @brief 直前に引いたパレット番号。同じ色の連続書き込みを速くする */
+  uint8_t last_index_{0};
+  /** @brief Scroll によって先頭行になった行の，記憶領域上の行番号
+   *
+   * 以下の opaque_spans_ と spans_dirty_ は記憶領域上の行番号で引く
+   */
+  int origin_row_{0};
+  /** @brief 行ごとの不透明なピクセルの範囲。透過色がある場合の描画に使う */
+  std::vector<std::vector<OpaqueSpan>> opaque_spans_{};
+  /** @brief 内容が変わって opaque_spans_ を作り直す必要がある行 */
+  std::vector<bool> spans_dirty_{};
+  /** @brief ピクセルごとの不透明度。記憶領域上の行番号で引く。
+   * FillAlpha を呼ぶまでは空 */
+  std::vector<uint8_t> alpha_{};
+  /** @brief kIndexed の内容を重ねて描く際に1行分を展開しておく領域 */
+  std::vector<uint32_t> row_buffer_{};
+
+  /** @brief kDirect 用の影バッファを確保する */
+  void InitializeShadowBuffer();
+  /** @brief kIndexed のときに色をパレット番号へ変換する
+   *
+   * パレットが溢れた場合は kDirect に切り替えて false を返す。
+   * 初めから kDirect の場合も false を返す。
+   */
+  bool PrepareIndices(const PixelColor *colors, uint8_t *indices, int count);
+  /** @brief 色に対応するパレット番号を返す。無ければ登録する。
+   * パレットが一杯なら nullopt */
+  std::optional<uint8_t> PaletteIndex(const PixelColor &c);
+  /** @brief パレット番号の内容を影バッファへ展開して kDirect に切り替える */
+  void ConvertToDirect();
+  /** @brief count 個のパレット番号をネイティブ形式のピクセル値へ展開する */
+  void ExpandIndices(uint32_t *dst, const uint8_t *src, int count) const;
+  /** @brief kIndexed の内容を dst へ展開しながら描画する */
+  void DrawIndexedTo(FrameBuffer &dst, Vector2D<int> position,
+                     const Rectangle<int> &area);
+  /** @brief 不透明度を使って dst の内容と重ねながら描画する */
+  void DrawBlendedTo(FrameBuffer &dst, Vector2D<int> position,
+                     const Rectangle<int> &area, uint8_t alpha);
+  /** @brief y 行目の opaque_spans_ を作り直す */
+  void UpdateOpaqueSpans(int y);
+  /** @brief 表示上の y 行目が記憶領域上の何行目かを返す */
+  int PhysicalRow(int y) const;
+  /** @brief 表示上の y 行目から rows 行の spans_dirty_ を立てる */
+  void MarkRowsDirty(int y, int rows);
+  /** @brief 表示上の [y, y + rows) 行を記憶領域上で連続する範囲に分け，
+   * 範囲ごとに f(表示上の先頭行, 記憶領域上の先頭行, 行数) を呼ぶ */
+  template <typename F> void ForEachRowRun(int y, int rows, F f) const {
+    while (rows > 0) {
+      const int py = PhysicalRow(y);
+      const int n = std::min(rows, height_ - py);
+      f(y, py, n);
+      y += n;
+      rows -= n;
+    }
+  }
+  /** @brief 平面描画領域内の指定した位置のピクセルへのポインタを返す
+   *
+   * pos は表示上の座標で，Scroll による回り込みを考慮して
+   * 記憶領域上の位置を求める
+   */
+  uint32_t *PixelAt(Vector2D<int> pos);
+  const uint32_t *PixelAt(Vector2D<int> pos) const;
+  /** @brief indices_ 内の指定した位置のパレット番号へのポインタを返す */
+  uint8_t *IndexAt(Vector2D<int> pos);
+  const uint8_t *IndexAt(Vector2D<int> pos) const;
 };
 
 void DrawWindow(PixelWriter &writer, const char *title);
@@ -0,0 +1,158 @@
+#include "zenkaku_font.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+extern const uint8_t _binary_zenkaku_bin_start[];
+extern const uint8_t _binary_zenkaku_bin_size[];
+
+namespace {
+const int kPageGlyphs = 256;
+const size_t kGlyphBytes = 32;
+/** @brief 文字の有無と幅を表すビット列の後ろに文字が並ぶ */
+const size_t kGlyphsOffset = 64;
+const size_t kPageBytes = kGlyphsOffset + kPageGlyphs * kGlyphBytes;
+const size_t kHeaderBytes = 8;
+const size_t kDirectoryEntryBytes = 12;
+/** @brief 展開済みのページを保持する数
+ *
+ * フォント全体を展開すると数 MiB になるので，使用中の数ページだけを持つ
+ */
+const int kCachedPages = 8;
+
+struct CachedPage {
+  bool valid;
+  uint32_t page;
+  /** @brief 最後に使ったときの use_count。最も小さいものを追い出す */
+  unsigned long last_used;
+  uint8_t data[kPageBytes];
+};
+
+CachedPage cached_pages[kCachedPages];
+unsigned long use_count = 0;
+unsigned long page_loads = 0;
+
+uint32_t ReadU32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+/** @brief page の圧縮データの位置と大きさを探す */
+bool FindPage(uint32_t page, const uint8_t *&data, size_t &size) {
+  const uint8_t *font = _binary_zenkaku_bin_start;
+  const auto font_size =
+      reinterpret_cast<uintptr_t>(_binary_zenkaku_bin_size);
+  if (font_size < kHeaderBytes || memcmp(font, "ZKF1", 4) != 0) {
+    return false;
+  }
+  const uint32_t count = ReadU32(font + 4);
+  if (kHeaderBytes + kDirectoryEntryBytes * count > font_size) {
+    return false;
+  }
+
+  // ページの一覧はページ番号の昇順に並んでいる
+  uint32_t lo = 0, hi = count;
+  while (lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    const uint8_t *entry = font + kHeaderBytes + kDirectoryEntryBytes * mid;
+    const uint32_t entry_page = ReadU32(entry);
+    if (entry_page < page) {
+      lo = mid + 1;
+    } else if (entry_page > page) {
+      hi = mid;
+    } else {
+      const uint32_t offset = ReadU32(entry + 4);
+      size = ReadU32(entry + 8);
+      if (offset > font_size || size > font_size - offset) {
+        return false;
+      }
+      data = font + offset;
+      return true;
+    }
+  }
+  return false;
+}
+
+/** @brief LZSS で圧縮された src を展開する
+ *
+ * 壊れたデータを読んでも dst からはみ出さず，
+ * ちょうど dst_size バイトに展開できたときだけ true を返す
+ */
+bool Decompress(const uint8_t *src, size_t src_size, uint8_t *dst,
+                size_t dst_size) {
+  size_t in = 0, out = 0;
+  while (out < dst_size) {
+    if (in >= src_size) {
+      return false;
+    }
+    const uint8_t flags = src[in++];
+    for (int bit = 0; bit < 8 && out < dst_size; ++bit) {
+      if (flags & (1u << bit)) {
+        if (in >= src_size) {
+          return false;
+        }
+        dst[out++] = src[in++];
+        continue;
+      }
+      if (in + 2 > src_size) {
+        return false;
+      }
+      const unsigned code = src[in] | (src[in + 1] << 8);
+      in += 2;
+      const size_t distance = (code >> 4) + 1;
+      const size_t length = (code & 0xfu) + 3;
+      if (distance > out || length > dst_size - out) {
+        return false;
+      }
+      // 参照元と重なることがあるので前から1バイトずつ写す
+      for (size_t i = 0; i < length; ++i, ++out) {
+        dst[out] = dst[out - distance];
+      }
+    }
+  }
+  return true;
+}
+
+/** @brief page を展開したデータを返す。フォントに無ければ nullptr */
+const uint8_t *GetPage(uint32_t page) {
+  ++use_count;
+  CachedPage *victim = &cached_pages[0];
+  for (auto &cached : cached_pages) {
+    if (cached.valid && cached.page == page) {
+      cached.last_used = use_count;
+      return cached.data;
+    }
+    if (!cached.valid) {
+      victim = &cached;
+    } else if (victim->valid && cached.last_used < victim->last_used) {
+      victim = &cached;
+    }
+  }
+
+  const uint8_t *data;
+  size_t size;
+  if (!FindPage(page, data, size)) {
+    return nullptr;
+  }
+  victim->valid = Decompress(data, size, victim->data, kPageBytes);
+  if (!victim->valid) {
+    return nullptr;
+  }
+  victim->page = page;
+  victim->last_used = use_count;
+  ++page_loads;
+  return victim->data;
+}
+} // namespace
+
+ZenkakuGlyph GetZenkakuGlyph(char32_t c) {
+  const uint8_t *page = GetPage(c >> 8);
+  const unsigned index = c & 0xffu;
+  if (page == nullptr || (page[index / 8] & (1u << (index % 8))) == 0) {
+    return {0, nullptr};
+  }
+  const bool wide = page[32 + index / 8] & (1u << (index % 8));
+  return {wide ? 16 : 8, page + kGlyphsOffset + kGlyphBytes * index};
+}
+
+unsigned long ZenkakuPageLoads() { return page_loads; }
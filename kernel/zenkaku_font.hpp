@@ -0,0 +1,29 @@
+/**
+ * @file zenkaku_font.hpp
+ *
+ * 圧縮して埋め込んだ全角フォント（tools/makezenkaku.py が生成する）を扱う。
+ * フォントは 256 文字ごとのページに分かれており，初めて使うときに展開して
+ * 上限付きの LRU キャッシュに保持する。
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/** @brief 全角フォントの1文字 */
+struct ZenkakuGlyph {
+  /** @brief 文字の幅（8 か 16）。フォントに無い文字なら 0 */
+  int width;
+  /** @brief 16 行分のビットマップ
+   *
+   * 各行 2 バイトで，左端が先頭バイトの最上位ビット。
+   * 次に GetZenkakuGlyph を呼ぶまで有効
+   */
+  const uint8_t *rows;
+};
+
+/** @brief コードポイント c の文字を全角フォントから探す */
+ZenkakuGlyph GetZenkakuGlyph(char32_t c);
+
+/** @brief これまでにページを展開した回数を返す */
+unsigned long ZenkakuPageLoads();
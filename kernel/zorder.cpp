@@ -0,0 +1,119 @@
+#include "zorder.hpp"
+
+ZOrder::~ZOrder() { DeleteTree(root_); }
+
+// zorder_insert_erase
+ZOrder::Node *ZOrder::Insert(Layer *layer, size_t height) {
+  auto node = new Node{layer, nullptr, nullptr, nullptr, NextPriority(), 1};
+  InsertNode(node, height);
+  return node;
+}
+
+void ZOrder::Erase(Node *node) {
+  Detach(node);
+  delete node;
+}
+
+void ZOrder::Move(Node *node, size_t height) {
+  Detach(node);
+  InsertNode(node, height);
+}
+
+void ZOrder::InsertNode(Node *node, size_t height) {
+  node->left = node->right = node->parent = nullptr;
+  node->size = 1;
+
+  Node *l, *r;
+  Split(root_, height, l, r);
+  root_ = Merge(Merge(l, node), r);
+  root_->parent = nullptr;
+}
+
+void ZOrder::Detach(Node *node) {
+  Node *l, *m, *r;
+  Split(root_, HeightOf(node), l, r);
+  Split(r, 1, m, r);
+  root_ = Merge(l, r);
+  if (root_) {
+    root_->parent = nullptr;
+  }
+}
+// zorder_insert_erase
+
+// zorder_height_of
+size_t ZOrder::HeightOf(const Node *node) const {
+  // 根に向かってたどり，自分より左にあるノードの数を数える
+  size_t height = SizeOf(node->left);
+  for (; node->parent; node = node->parent) {
+    if (node->parent->right == node) {
+      height += SizeOf(node->parent->left) + 1;
+    }
+  }
+  return height;
+}
+// zorder_height_of
+
+size_t ZOrder::Size() const { return SizeOf(root_); }
+
+// zorder_treap
+uint32_t ZOrder::NextPriority() {
+  // xorshift32
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+  return random_state_;
+}
+
+void ZOrder::Split(Node *t, size_t k, Node *&l, Node *&r) {
+  if (t == nullptr) {
+    l = r = nullptr;
+    return;
+  }
+  if (SizeOf(t->left) < k) {
+    Split(t->right, k - SizeOf(t->left) - 1, t->right, r);
+    l = t;
+  } else {
+    Split(t->left, k, l, t->left);
+    r = t;
+  }
+  Update(t);
+}
+
+ZOrder::Node *ZOrder::Merge(Node *l, Node *r) {
+  if (l == nullptr) {
+    return r;
+  }
+  if (r == nullptr) {
+    return l;
+  }
+  if (l->priority > r->priority) {
+    l->right = Merge(l->right, r);
+    Update(l);
+    return l;
+  }
+  r->left = Merge(l, r->left);
+  Update(r);
+  return r;
+}
+
+void ZOrder::Update(Node *node) {
+  node->size = SizeOf(node->left) + SizeOf(node->right) + 1;
+  if (node->left) {
+    node->left->parent = node;
+  }
+  if (node->right) {
+    node->right->parent = node;
+  }
+}
+
+size_t ZOrder::SizeOf(const Node *node) { return node ? node->size : 0; }
+
+void ZOrder::DeleteTree(Node *node) {
+  if (node == nullptr) {
+    return;
+  }
+  DeleteTree(node->left);
+  DeleteTree(node->right);
+  delete node;
+}
+// zorder_treap
@@ -0,0 +1,60 @@
+/**
+ * @file zorder.hpp
+ *
+ * レイヤの重なり順を保持する。高さ（最背面を 0 とする順位）を暗黙のキーとする
+ * Treap で実装し，挿入・削除・高さの取得を平均 O(log n) で行う。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Layer;
+
+class ZOrder {
+public:
+  /** @brief 重なり順の中の1つのレイヤ */
+  struct Node {
+    Layer *layer;
+    Node *left, *right, *parent;
+    uint32_t priority;
+    /** @brief このノードを根とする部分木のノード数 */
+    size_t size;
+  };
+
+  ZOrder() = default;
+  ZOrder(const ZOrder &) = delete;
+  ZOrder &operator=(const ZOrder &) = delete;
+  ~ZOrder();
+
+  /** @brief layer を高さ height の位置に挿入し，そのノードを返す
+   *
+   * height が Size() 以上なら最前面に挿入する
+   */
+  Node *Insert(Layer *layer, size_t height);
+  /** @brief node を取り除いて解放する */
+  void Erase(Node *node);
+  /** @brief node を取り除き，残りの順序での高さ height の位置に入れ直す */
+  void Move(Node *node, size_t height);
+  /** @brief node の高さを返す */
+  size_t HeightOf(const Node *node) const;
+  /** @brief 表示されているレイヤの数を返す */
+  size_t Size() const;
+
+private:
+  Node *root_{nullptr};
+  uint32_t random_state_{2463534242};
+
+  uint32_t NextPriority();
+  /** @brief t を先頭から k 個のノードとそれ以外に分ける */
+  static void Split(Node *t, size_t k, Node *&l, Node *&r);
+  static Node *Merge(Node *l, Node *r);
+  static void Update(Node *node);
+  static size_t SizeOf(const Node *node);
+  static void DeleteTree(Node *node);
+  /** @brief 取り除いた node を高さ height の位置に入れる */
+  void InsertNode(Node *node, size_t height);
+  /** @brief node を木から外す。node 自身は解放しない */
+  void Detach(Node *node);
+};
@@ -0,0 +1,215 @@
+#!/usr/bin/python3
+"""PNG や PPM の画像を，カーネルがそのまま転送できるバイナリへ変換する。
+
+入力は PNG（8 ビット，インターレースなし）か PPM（P3/P6）。PPM には透明度が
+無いので，--key で指定した色（既定はマゼンタ ff00ff）を透明として扱う。
+ピクセルはフレームバッファと同じ 32 ビット形式で，色は不透明度を乗算済みにする。
+各行は透明なピクセルを飛ばした「スパン」の並びとして持つので，実行時は
+スパンごとにコピーするか重ねるだけでよい。
+
+出力形式（数値はすべてリトルエンディアン，各要素は 4 バイト境界に揃う）:
+  magic        "IMG1"
+  width        uint16
+  height       uint16
+  format       uint32  ピクセル形式（0: RGB, 1: BGR。PixelFormat と同じ値）
+  rows         height 個の uint32。各行のデータの先頭のファイル内オフセット
+  行のデータ   span_count: uint16, reserved: uint16 に続いて span_count 個の
+               {x: uint16, length: uint16, pixels: length 個の uint32}
+               length の最上位ビットが 1 なら半透明のスパン
+               （下位 15 ビットが長さ）
+
+ピクセルの下位 24 ビットは format の並びの色，上位 8 ビットは不透明度。
+不透明なスパンの上位 8 ビットは 0 にしてあり，そのまま書き込める。
+"""
+
+import argparse
+import struct
+import zlib
+
+FORMATS = {"rgb": 0, "bgr": 1}
+TRANSLUCENT = 0x8000
+MAX_SPAN = 0x7fff
+
+
+def load_ppm(data: bytes, key) -> tuple:
+    """PPM を (幅, 高さ, [(r, g, b, a), ...]) に変換する"""
+    tokens = []
+    pos = 0
+    # ヘッダは magic，幅，高さ，最大値の 4 語。# から行末まではコメント
+    while len(tokens) < 4:
+        while data[pos:pos + 1].isspace():
+            pos += 1
+        if data[pos:pos + 1] == b"#":
+            pos = data.index(b"\n", pos)
+            continue
+        start = pos
+        while not data[pos:pos + 1].isspace():
+            pos += 1
+        tokens.append(data[start:pos])
+    magic, width, height, maxval = (tokens[0], int(tokens[1]),
+                                    int(tokens[2]), int(tokens[3]))
+    if magic == b"P6":
+        if maxval >= 256:
+            raise ValueError("16-bit PPM is not supported")
+        body = data[pos + 1:pos + 1 + 3 * width * height]
+        values = list(body)
+    elif magic == b"P3":
+        values = [int(v) for v in data[pos:].split()[:3 * width * height]]
+    else:
+        raise ValueError("not a PPM file")
+    if len(values) < 3 * width * height:
+        raise ValueError("truncated PPM file")
+
+    pixels = []
+    for i in range(width * height):
+        rgb = tuple(v * 255 // maxval for v in values[3 * i:3 * i + 3])
+        pixels.append(rgb + (0 if rgb == key else 255,))
+    return width, height, pixels
+
+
+def paeth(a: int, b: int, c: int) -> int:
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def load_png(data: bytes) -> tuple:
+    """PNG を (幅, 高さ, [(r, g, b, a), ...]) に変換する"""
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("not a PNG file")
+    pos = 8
+    idat = bytearray()
+    palette, trns = [], b""
+    while pos < len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            (width, height, depth, color_type,
+             _, _, interlace) = struct.unpack(">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = [tuple(body[i:i + 3]) for i in range(0, length, 3)]
+        elif kind == b"tRNS":
+            trns = body
+        elif kind == b"IDAT":
+            idat += body
+        elif kind == b"IEND":
+            break
+    if depth != 8 or interlace != 0:
+        raise ValueError("only 8-bit non-interlaced PNG is supported")
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color_type]
+
+    raw = zlib.decompress(bytes(idat))
+    stride = channels * width
+    prev = bytearray(stride)
+    rows = []
+    for y in range(height):
+        filter_type = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for i in range(stride):
+            a = line[i - channels] if i >= channels else 0
+            b = prev[i]
+            c = prev[i - channels] if i >= channels else 0
+            if filter_type == 1:
+                line[i] = (line[i] + a) & 0xff
+            elif filter_type == 2:
+                line[i] = (line[i] + b) & 0xff
+            elif filter_type == 3:
+                line[i] = (line[i] + (a + b) // 2) & 0xff
+            elif filter_type == 4:
+                line[i] = (line[i] + paeth(a, b, c)) & 0xff
+        rows.append(line)
+        prev = line
+
+    pixels = []
+    for line in rows:
+        for x in range(width):
+            v = line[channels * x:channels * (x + 1)]
+            if color_type == 0:
+                pixels.append((v[0], v[0], v[0], 255))
+            elif color_type == 2:
+                pixels.append((v[0], v[1], v[2], 255))
+            elif color_type == 3:
+                alpha = trns[v[0]] if v[0] < len(trns) else 255
+                pixels.append(palette[v[0]] + (alpha,))
+            elif color_type == 4:
+                pixels.append((v[0], v[0], v[0], v[1]))
+            else:
+                pixels.append(tuple(v))
+    return width, height, pixels
+
+
+def to_native(pixel: tuple, fmt: int) -> int:
+    """ピクセルを不透明度を乗算済みの 32 ビット値に変換する"""
+    r, g, b, a = pixel
+    if a < 255:
+        r, g, b = ((c * a + 127) // 255 for c in (r, g, b))
+    if fmt == FORMATS["rgb"]:
+        value = r | (g << 8) | (b << 16)
+    else:
+        value = b | (g << 8) | (r << 16)
+    return value | ((a << 24) if a < 255 else 0)
+
+
+def encode_row(row: list, fmt: int) -> bytes:
+    spans = []
+    x = 0
+    while x < len(row):
+        alpha = row[x][3]
+        if alpha == 0:
+            x += 1
+            continue
+        # 不透明なピクセルと半透明なピクセルは別のスパンにする
+        opaque = alpha == 255
+        begin = x
+        while (x < len(row) and x - begin < MAX_SPAN and row[x][3] != 0
+               and (row[x][3] == 255) == opaque):
+            x += 1
+        span = struct.pack("<HH", begin,
+                           (x - begin) | (0 if opaque else TRANSLUCENT))
+        span += b"".join(struct.pack("<I", to_native(p, fmt))
+                         for p in row[begin:x])
+        spans.append(span)
+    return struct.pack("<HH", len(spans), 0) + b"".join(spans)
+
+
+def compile(width: int, height: int, pixels: list, fmt: int) -> bytes:
+    if width > 0xffff or height > 0xffff:
+        raise ValueError("image is too large")
+    rows = [encode_row(pixels[y * width:(y + 1) * width], fmt)
+            for y in range(height)]
+    header = bytearray(b"IMG1" + struct.pack("<HHI", width, height, fmt))
+    offset = len(header) + 4 * height
+    for row in rows:
+        header += struct.pack("<I", offset)
+        offset += len(row)
+    return bytes(header) + b"".join(rows)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("image", help="path to a .png or .ppm file")
+    parser.add_argument("-o", help="path to an output file",
+                        default="image.img")
+    parser.add_argument("--format", choices=FORMATS.keys(), default="bgr",
+                        help="pixel format of the output")
+    parser.add_argument("--key", default="ff00ff",
+                        help="transparent color of a PPM file (RRGGBB)")
+    ns = parser.parse_args()
+
+    with open(ns.image, "rb") as f:
+        data = f.read()
+    if data[:2] in (b"P3", b"P6"):
+        key = tuple(bytes.fromhex(ns.key))
+        width, height, pixels = load_ppm(data, key)
+    else:
+        width, height, pixels = load_png(data)
+
+    with open(ns.o, "wb") as out:
+        out.write(compile(width, height, pixels, FORMATS[ns.format]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,204 @@
+#!/usr/bin/python3
+"""全角フォントを圧縮したページ単位のバイナリへ変換する。
+
+入力は GNU Unifont 形式の .hex か BDF（ISO10646 または JIS X 0208 符号化）。
+出力は 256 文字ごとのページを LZSS で圧縮し，先頭にページの一覧を置いたもの。
+入力を指定しなければページを持たない空のフォントを出力する。
+
+出力形式（数値はすべてリトルエンディアン）:
+  magic        "ZKF1"
+  page_count   uint32
+  directory    page_count 個の {page: uint32, offset: uint32, size: uint32}
+               page はコードポイントの上位ビット（code >> 8）で昇順に並ぶ
+  pages        各ページの圧縮データ
+
+展開後のページ（8256 バイト）:
+  present      32 バイト。ビット i が 1 なら i 番目の文字がある
+  wide         32 バイト。ビット i が 1 なら i 番目の文字は幅 16
+  glyphs       256 文字 x 16 行 x 2 バイト。各行は左端が最上位ビット
+
+圧縮データは「フラグ 1 バイト + 8 個の要素」の繰り返し。フラグの下位ビットから順に
+1 ならリテラル 1 バイト，0 なら 2 バイトの参照
+(((距離 - 1) << 4) | (長さ - 3)，距離 1〜4096，長さ 3〜18)。
+"""
+
+import argparse
+import struct
+
+GLYPH_HEIGHT = 16
+PAGE_GLYPHS = 256
+GLYPH_BYTES = 2 * GLYPH_HEIGHT
+PAGE_BYTES = 32 + 32 + PAGE_GLYPHS * GLYPH_BYTES
+
+MAX_DISTANCE = 4096
+MIN_MATCH = 3
+MAX_MATCH = 18
+MAX_CANDIDATES = 64
+
+
+def load_hex(src: str) -> dict:
+    """Unifont の .hex を {コードポイント: (幅, 16 行分の整数)} に変換する"""
+    glyphs = {}
+    for line in src.splitlines():
+        line = line.strip()
+        if not line or line.startswith("#"):
+            continue
+        code, bitmap = line.split(":")
+        code = int(code, 16)
+        if len(bitmap) == 32:
+            rows = [int(bitmap[2 * i:2 * i + 2], 16) << 8 for i in range(16)]
+            glyphs[code] = (8, rows)
+        elif len(bitmap) == 64:
+            rows = [int(bitmap[4 * i:4 * i + 4], 16) for i in range(16)]
+            glyphs[code] = (16, rows)
+    return glyphs
+
+
+def jis_to_unicode(code: int):
+    """JIS X 0208 の区点を表す 16 ビット値を Unicode のコードポイントに変換する"""
+    try:
+        c = bytes([(code >> 8) | 0x80, (code & 0xff) | 0x80]).decode("euc_jp")
+    except UnicodeDecodeError:
+        return None
+    return ord(c) if len(c) == 1 else None
+
+
+def load_bdf(src: str) -> dict:
+    """BDF を {コードポイント: (幅, 16 行分の整数)} に変換する"""
+    glyphs = {}
+    registry = ""
+    ascent = GLYPH_HEIGHT
+    lines = iter(src.splitlines())
+    for line in lines:
+        words = line.split()
+        if not words:
+            continue
+        if words[0] == "CHARSET_REGISTRY":
+            registry = words[1].strip('"').upper()
+        elif words[0] == "FONT_ASCENT":
+            ascent = int(words[1])
+        elif words[0] == "STARTCHAR":
+            code, width, bbx, bitmap = None, 8, (0, 0, 0, 0), []
+            for line in lines:
+                words = line.split()
+                if words[0] == "ENCODING":
+                    code = int(words[1])
+                elif words[0] == "DWIDTH":
+                    width = int(words[1])
+                elif words[0] == "BBX":
+                    bbx = tuple(int(w) for w in words[1:5])
+                elif words[0] == "BITMAP":
+                    for line in lines:
+                        if line.startswith("ENDCHAR"):
+                            break
+                        bitmap.append(line.strip())
+                    break
+            if code is None or code < 0:
+                continue
+            if registry.startswith("JISX0208"):
+                code = jis_to_unicode(code)
+                if code is None:
+                    continue
+            w, h, xoff, yoff = bbx
+            rows = [0] * GLYPH_HEIGHT
+            top = ascent - (yoff + h)
+            for i, bits in enumerate(bitmap):
+                y = top + i
+                if not bits or y < 0 or y >= GLYPH_HEIGHT:
+                    continue
+                value = int(bits, 16) >> (4 * len(bits) - w)
+                shift = 16 - xoff - w
+                rows[y] = (value << shift if shift >= 0
+                           else value >> -shift) & 0xffff
+            glyphs[code] = (16 if width > 8 else 8, rows)
+    return glyphs
+
+
+def make_page(glyphs: dict, page: int) -> bytes:
+    present = bytearray(32)
+    wide = bytearray(32)
+    body = bytearray(PAGE_GLYPHS * GLYPH_BYTES)
+    for i in range(PAGE_GLYPHS):
+        glyph = glyphs.get((page << 8) | i)
+        if glyph is None:
+            continue
+        width, rows = glyph
+        present[i // 8] |= 1 << (i % 8)
+        if width == 16:
+            wide[i // 8] |= 1 << (i % 8)
+        for y, row in enumerate(rows):
+            struct.pack_into(">H", body, i * GLYPH_BYTES + 2 * y, row)
+    return bytes(present + wide + body)
+
+
+def compress(src: bytes) -> bytes:
+    out = bytearray()
+    heads = {}
+    pos = 0
+    while pos < len(src):
+        flag_index = len(out)
+        out.append(0)
+        for bit in range(8):
+            if pos >= len(src):
+                break
+            best_len, best_dist = 0, 0
+            cands = heads.get(src[pos:pos + MIN_MATCH], [])
+            for cand in reversed(cands[-MAX_CANDIDATES:]):
+                dist = pos - cand
+                if dist > MAX_DISTANCE:
+                    break
+                length = 0
+                while (length < MAX_MATCH and pos + length < len(src)
+                       and src[cand + length] == src[pos + length]):
+                    length += 1
+                if length > best_len:
+                    best_len, best_dist = length, dist
+                    if length == MAX_MATCH:
+                        break
+            if best_len >= MIN_MATCH:
+                code = ((best_dist - 1) << 4) | (best_len - MIN_MATCH)
+                out += struct.pack("<H", code)
+                step = best_len
+            else:
+                out[flag_index] |= 1 << bit
+                out.append(src[pos])
+                step = 1
+            for p in range(pos, pos + step):
+                heads.setdefault(src[p:p + MIN_MATCH], []).append(p)
+            pos += step
+    return bytes(out)
+
+
+def compile(glyphs: dict) -> bytes:
+    pages = sorted({code >> 8 for code in glyphs if code < 0x110000})
+    data = [compress(make_page(glyphs, page)) for page in pages]
+    header = bytearray(b"ZKF1" + struct.pack("<I", len(pages)))
+    offset = len(header) + 12 * len(pages)
+    for page, d in zip(pages, data):
+        header += struct.pack("<III", page, offset, len(d))
+        offset += len(d)
+    return bytes(header) + b"".join(data)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("font", nargs="?",
+                        help="path to a .hex or .bdf font file")
+    parser.add_argument("-o", help="path to an output file",
+                        default="zenkaku.bin")
+    ns = parser.parse_args()
+
+    glyphs = {}
+    if ns.font:
+        with open(ns.font, encoding="latin-1") as font:
+            src = font.read()
+        glyphs = load_bdf(src) if "STARTFONT" in src[:64] else load_hex(src)
+        # 半角の ASCII は hankaku.bin を使う
+        glyphs = {c: g for c, g in glyphs.items() if c >= 0x80}
+
+    with open(ns.o, "wb") as out:
+        out.write(compile(glyphs))
+
+
+if __name__ == "__main__":
+    main()